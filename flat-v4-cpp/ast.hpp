@@ -1,207 +1,17 @@
 #pragma once
+#include <exception>
 #include <memory>
+#include <span>
 #include <string_view>
 #include <vector>
 #include <unordered_map>
 
 #include "token.hpp"
 #include "type.hpp"
+#include "interner.hpp"
+#include "pool_allocator.hpp"
 #include "visitor.hpp"
 
-namespace AstExp
-{
-	using Visitor = visitor::Visitor<
-		struct AstNode,
-		struct Declaration,
-		struct Statement,
-		struct Expression,
-		struct UnaryExpression,
-		struct BinaryExpression,
-		struct IntegerExpression,
-		struct IdentifierExpression,
-		struct CallExpression,
-		struct IndexExpression,
-		struct BlockStatement,
-		struct VariableStatement,
-		struct ReturnStatement,
-		struct WhileStatement,
-		struct IfStatement,
-		struct FunctionDeclaration,
-		struct Module
-	>;
-
-	template<typename T>
-	using Visitable = ::Visitable<T,
-		struct AstNode,
-		struct Declaration,
-		struct Statement,
-		struct Expression,
-		struct UnaryExpression,
-		struct BinaryExpression,
-		struct IntegerExpression,
-		struct IdentifierExpression,
-		struct CallExpression,
-		struct IndexExpression,
-		struct BlockStatement,
-		struct VariableStatement,
-		struct ReturnStatement,
-		struct WhileStatement,
-		struct IfStatement,
-		struct FunctionDeclaration,
-		struct Module
-	>;
-
-	struct AstNode : public Visitable<AstNode>
-	{
-		size_t begin, end;
-
-		AstNode(size_t begin, size_t end) :
-			begin(begin), end(end) { }
-	};
-
-	struct Declaration : public AstNode, public Visitable<Declaration>
-	{
-		Declaration(size_t begin, size_t end) :
-			AstNode(begin, end) { }
-	};
-
-	struct Statement : public AstNode
-	{
-		Statement(size_t begin, size_t end) :
-			AstNode(begin, end) { }
-	};
-
-	struct Expression : public Statement
-	{
-		Expression(size_t begin, size_t end) :
-			Statement(begin, end) { }
-	};
-
-	///////////////////////////////////////////
-
-	struct UnaryExpression : public Expression
-	{
-		Token type;
-		std::shared_ptr<Expression> expression;
-
-		UnaryExpression(size_t begin, size_t end, Token type, std::shared_ptr<Expression> expression) :
-			Expression(begin, end), type(type), expression(expression) { }
-	};
-
-	struct BinaryExpression : public Expression
-	{
-		Token type;
-		std::shared_ptr<Expression> left, right;
-
-		BinaryExpression(size_t begin, size_t end, Token type, std::shared_ptr<Expression> left, std::shared_ptr<Expression> right) :
-			Expression(begin, end), type(type), left(left), right(right) { }
-	};
-
-	struct IntegerExpression : public Expression
-	{
-		std::string value;
-
-		IntegerExpression(size_t begin, size_t end, std::string value) :
-			Expression(begin, end), value(value) { }
-	};
-
-	struct IdentifierExpression : public Expression
-	{
-		std::string value;
-
-		IdentifierExpression(size_t begin, size_t end, std::string value) :
-			Expression(begin, end), value(value) { }
-	};
-
-	struct CallExpression : public Expression
-	{
-		std::shared_ptr<Expression> expression;
-		std::vector<std::shared_ptr<Expression>> args;
-		std::string functionIdentifier;
-
-		CallExpression(size_t begin, size_t end, std::shared_ptr<Expression> expression, std::vector<std::shared_ptr<Expression>> args) :
-			Expression(begin, end), expression(expression), args(args) { }
-	};
-
-	struct IndexExpression : public Expression
-	{
-		std::shared_ptr<Expression> expression;
-		std::vector<std::shared_ptr<Expression>> args;
-
-		IndexExpression(size_t begin, size_t end, std::shared_ptr<Expression> expression, std::vector<std::shared_ptr<Expression>> args) :
-			Expression(begin, end), expression(expression), args(args) { }
-	};
-
-	///////////////////////////////////////////
-
-	struct BlockStatement : public Statement
-	{
-		std::vector<std::shared_ptr<Statement>> statements;
-
-		BlockStatement(size_t begin, size_t end, std::vector<std::shared_ptr<Statement>> statements) :
-			Statement(begin, end), statements(statements) { }
-	};
-
-	struct VariableStatement : public Statement
-	{
-		std::vector<std::string> names;
-		std::vector<std::shared_ptr<Expression>> values;
-
-		VariableStatement(size_t begin, size_t end, std::vector<std::string> names, std::vector<std::shared_ptr<Expression>> values) :
-			Statement(begin, end), names(names), values(values) { }
-	};
-
-	struct ReturnStatement : public Statement
-	{
-		std::shared_ptr<Expression> expression;
-
-		ReturnStatement(size_t begin, size_t end, std::shared_ptr<Expression> expression) :
-			Statement(begin, end), expression(expression) { }
-	};
-
-	struct WhileStatement : public Statement
-	{
-		std::shared_ptr<Expression> condition;
-		std::shared_ptr<Statement> body;
-
-		WhileStatement(size_t begin, size_t end, std::shared_ptr<Expression> condition, std::shared_ptr<Statement> body) :
-			Statement(begin, end), condition(condition), body(body) { }
-	};
-
-	struct IfStatement : public Statement
-	{
-		std::shared_ptr<Expression> condition;
-		std::shared_ptr<Statement> ifBody, elseBody;
-
-		IfStatement(size_t begin, size_t end, std::shared_ptr<Expression> condition, std::shared_ptr<Statement> ifBody, std::shared_ptr<Statement> elseBody) :
-			Statement(begin, end), condition(condition), ifBody(ifBody), elseBody(elseBody) { }
-	};
-
-	///////////////////////////////////////////
-
-	struct FunctionDeclaration : public Declaration
-	{
-		std::string name;
-		Type* result;
-		std::vector<std::pair<std::string, Type*>> parameters;
-		std::shared_ptr<Statement> body;
-		std::vector<std::pair<std::string, Type*>> localVariables;
-
-		FunctionDeclaration(size_t begin, size_t end, std::string name, Type* result, std::vector<std::pair<std::string, Type*>> parameters, std::shared_ptr<Statement> body) :
-			Declaration(begin, end), name(name), result(result), parameters(parameters), body(body) { }
-	};
-
-	///////////////////////////////////////////
-
-	struct Module : public AstNode
-	{
-		std::vector<std::shared_ptr<Declaration>> declarations;
-
-		Module(size_t begin, size_t end, std::vector<std::shared_ptr<Declaration>> declarations) :
-			AstNode(begin, end), declarations(declarations) { }
-	};
-}
-
 using Visitor = visitor::Visitor<
 	struct AstNode,
 	struct IntegerExpression,
@@ -219,12 +29,41 @@ using Visitor = visitor::Visitor<
 	struct Module
 >;
 
+struct AstVisitor : public Visitor
+{
+	using Visitor::visit;
+
+	// dispatches to the visit overload of the dynamic node type
+	void visit(AstNode* node) override;
+};
+
+// concrete node type, lets passes dispatch with a switch instead of dynamic_cast or accept
+enum class AstKind : uint8_t
+{
+	IntegerExpression,
+	IdentifierExpression,
+	UnaryExpression,
+	BinaryExpression,
+	CallExpression,
+	IndexExpression,
+
+	BlockStatement,
+	VariableStatement,
+	ReturnStatement,
+	WhileStatement,
+	IfStatement,
+
+	FunctionDeclaration,
+	Module,
+};
+
 struct AstNode
 {
+	AstKind kind;
 	size_t begin, end;
 
-	AstNode(size_t begin, size_t end) :
-		begin(begin), end(end) { }
+	AstNode(AstKind kind, size_t begin, size_t end) :
+		kind(kind), begin(begin), end(end) { }
 
 	virtual void accept(Visitor* visitor) { }
 };
@@ -233,24 +72,27 @@ struct AstNode
 
 struct Declaration : public AstNode
 {
-	Declaration(size_t begin, size_t end) : 
-		AstNode(begin, end) { }
+	Declaration(AstKind kind, size_t begin, size_t end) : 
+		AstNode(kind, begin, end) { }
 
 	IMPLEMENT_ACCEPT()
 };
 
 struct Statement : public AstNode
 {
-	Statement(size_t begin, size_t end) : 
-		AstNode(begin, end) { }
+	Statement(AstKind kind, size_t begin, size_t end) : 
+		AstNode(kind, begin, end) { }
 
 	IMPLEMENT_ACCEPT()
 };
 
 struct Expression : public Statement
 {
-	Expression(size_t begin, size_t end) : 
-		Statement(begin, end) { }
+	// set by the semantic pass, null until then or if the value has a type that does not exist
+	Type* resolvedType;
+
+	Expression(AstKind kind, size_t begin, size_t end) : 
+		Statement(kind, begin, end), resolvedType(nullptr) { }
 
 	IMPLEMENT_ACCEPT()
 };
@@ -260,10 +102,14 @@ struct Expression : public Statement
 struct UnaryExpression : public Expression
 {
 	Token type;
-	std::shared_ptr<Expression> expression;
+	Expression* expression;
 
-	UnaryExpression(size_t begin, size_t end, Token type, std::shared_ptr<Expression> expression) : 
-		Expression(begin, end), type(type), expression(expression) { }
+	// set by the semantic pass, either the intrinsic or the operator function that is applied
+	Intrinsic const* intrinsic;
+	FunctionDeclaration* target;
+
+	UnaryExpression(size_t begin, size_t end, Token type, Expression* expression) : 
+		Expression(AstKind::UnaryExpression, begin, end), type(type), expression(expression), intrinsic(nullptr), target(nullptr) { }
 
 	IMPLEMENT_ACCEPT()
 };
@@ -271,53 +117,63 @@ struct UnaryExpression : public Expression
 struct BinaryExpression : public Expression
 {
 	Token type;
-	std::shared_ptr<Expression> left, right;
+	Expression* left;
+	Expression* right;
+
+	// set by the semantic pass, either the intrinsic or the operator function that is applied. both are null for assignments
+	Intrinsic const* intrinsic;
+	FunctionDeclaration* target;
 
-	BinaryExpression(size_t begin, size_t end, Token type, std::shared_ptr<Expression> left, std::shared_ptr<Expression> right) : 
-		Expression(begin, end), type(type), left(left), right(right) { }
+	BinaryExpression(size_t begin, size_t end, Token type, Expression* left, Expression* right) : 
+		Expression(AstKind::BinaryExpression, begin, end), type(type), left(left), right(right), intrinsic(nullptr), target(nullptr) { }
 
 	IMPLEMENT_ACCEPT()
 };
 
 struct IntegerExpression : public Expression
 {
-	std::string value;
+	uint64_t value;
 
-	IntegerExpression(size_t begin, size_t end, std::string value) : 
-		Expression(begin, end), value(value) { }
+	// the type of a width suffix like in 255u8, null if the literal has none
+	Type* suffixType;
+
+	IntegerExpression(size_t begin, size_t end, uint64_t value, Type* suffixType) : 
+		Expression(AstKind::IntegerExpression, begin, end), value(value), suffixType(suffixType) { }
 
 	IMPLEMENT_ACCEPT()
 };
 
 struct IdentifierExpression : public Expression
 {
-	std::string value;
+	Symbol value;
 
-	IdentifierExpression(size_t begin, size_t end, std::string value) : 
-		Expression(begin, end), value(value) { }
+	IdentifierExpression(size_t begin, size_t end, Symbol value) : 
+		Expression(AstKind::IdentifierExpression, begin, end), value(value) { }
 
 	IMPLEMENT_ACCEPT()
 };
 
 struct CallExpression : public Expression
 {
-	std::shared_ptr<Expression> expression;
-	std::vector<std::shared_ptr<Expression>> args;
-	std::string functionIdentifier;
+	Expression* expression;
+	std::span<Expression*> args;
+
+	// the overload that is called, set by the semantic pass
+	FunctionDeclaration* target;
 
-	CallExpression(size_t begin, size_t end, std::shared_ptr<Expression> expression, std::vector<std::shared_ptr<Expression>> args) : 
-		Expression(begin, end), expression(expression), args(args) { }
+	CallExpression(size_t begin, size_t end, Expression* expression, std::span<Expression*> args) : 
+		Expression(AstKind::CallExpression, begin, end), expression(expression), args(args), target(nullptr) { }
 
 	IMPLEMENT_ACCEPT()
 };
 
 struct IndexExpression : public Expression
 {
-	std::shared_ptr<Expression> expression;
-	std::vector<std::shared_ptr<Expression>> args;
+	Expression* expression;
+	std::span<Expression*> args;
 
-	IndexExpression(size_t begin, size_t end, std::shared_ptr<Expression> expression, std::vector<std::shared_ptr<Expression>> args) : 
-		Expression(begin, end), expression(expression), args(args) { }
+	IndexExpression(size_t begin, size_t end, Expression* expression, std::span<Expression*> args) : 
+		Expression(AstKind::IndexExpression, begin, end), expression(expression), args(args) { }
 
 	IMPLEMENT_ACCEPT()
 };
@@ -326,53 +182,54 @@ struct IndexExpression : public Expression
 
 struct BlockStatement : public Statement
 {
-	std::vector<std::shared_ptr<Statement>> statements;
+	std::span<Statement*> statements;
 
-	BlockStatement(size_t begin, size_t end, std::vector<std::shared_ptr<Statement>> statements) : 
-		Statement(begin, end), statements(statements) { }
+	BlockStatement(size_t begin, size_t end, std::span<Statement*> statements) : 
+		Statement(AstKind::BlockStatement, begin, end), statements(statements) { }
 
 	IMPLEMENT_ACCEPT()
 };
 
 struct VariableStatement : public Statement
 {
-	std::vector<std::string> names;
-	std::vector<std::shared_ptr<Expression>> values;
+	std::span<Symbol> names;
+	std::span<Expression*> values;
 
-	VariableStatement(size_t begin, size_t end, std::vector<std::string> names, std::vector<std::shared_ptr<Expression>> values) : 
-		Statement(begin, end), names(names), values(values) { }
+	VariableStatement(size_t begin, size_t end, std::span<Symbol> names, std::span<Expression*> values) : 
+		Statement(AstKind::VariableStatement, begin, end), names(names), values(values) { }
 
 	IMPLEMENT_ACCEPT()
 };
 
 struct ReturnStatement : public Statement
 {
-	std::shared_ptr<Expression> expression;
+	Expression* expression;
 
-	ReturnStatement(size_t begin, size_t end, std::shared_ptr<Expression> expression) : 
-		Statement(begin, end), expression(expression) { }
+	ReturnStatement(size_t begin, size_t end, Expression* expression) : 
+		Statement(AstKind::ReturnStatement, begin, end), expression(expression) { }
 
 	IMPLEMENT_ACCEPT()
 };
 
 struct WhileStatement : public Statement
 {
-	std::shared_ptr<Expression> condition;
-	std::shared_ptr<Statement> body;
+	Expression* condition;
+	Statement* body;
 
-	WhileStatement(size_t begin, size_t end, std::shared_ptr<Expression> condition, std::shared_ptr<Statement> body) : 
-		Statement(begin, end), condition(condition), body(body) { }
+	WhileStatement(size_t begin, size_t end, Expression* condition, Statement* body) : 
+		Statement(AstKind::WhileStatement, begin, end), condition(condition), body(body) { }
 
 	IMPLEMENT_ACCEPT()
 };
 
 struct IfStatement : public Statement
 {
-	std::shared_ptr<Expression> condition;
-	std::shared_ptr<Statement> ifBody, elseBody;
+	Expression* condition;
+	Statement* ifBody;
+	Statement* elseBody;
 
-	IfStatement(size_t begin, size_t end, std::shared_ptr<Expression> condition, std::shared_ptr<Statement> ifBody, std::shared_ptr<Statement> elseBody) : 
-		Statement(begin, end), condition(condition), ifBody(ifBody), elseBody(elseBody) { }
+	IfStatement(size_t begin, size_t end, Expression* condition, Statement* ifBody, Statement* elseBody) : 
+		Statement(AstKind::IfStatement, begin, end), condition(condition), ifBody(ifBody), elseBody(elseBody) { }
 
 	IMPLEMENT_ACCEPT()
 };
@@ -381,26 +238,61 @@ struct IfStatement : public Statement
 
 struct FunctionDeclaration : public Declaration
 {
-	std::string name;
+	Symbol name;
 	Type* result;
-	std::vector<std::pair<std::string, Type*>> parameters;
-	std::shared_ptr<Statement> body;
-	std::vector<std::pair<std::string, Type*>> localVariables;
+	std::span<std::pair<Symbol, Type*>> parameters;
+	Statement* body;
+	std::vector<std::pair<Symbol, Type*>> localVariables;
+
+	// name with the parameter types the function is given to the linker with, so overloads get distinct symbols.
+	// set by FunctionTable::assignLinkNames
+	Symbol linkName;
 
-	FunctionDeclaration(size_t begin, size_t end, std::string name, Type* result, std::vector<std::pair<std::string, Type*>> parameters, std::shared_ptr<Statement> body) : 
-		Declaration(begin, end), name(name), result(result), parameters(parameters), body(body) { }
+	FunctionDeclaration(size_t begin, size_t end, Symbol name, Type* result, std::span<std::pair<Symbol, Type*>> parameters, Statement* body) : 
+		Declaration(AstKind::FunctionDeclaration, begin, end), name(name), result(result), parameters(parameters), body(body), linkName() { }
 
 	IMPLEMENT_ACCEPT()
 };
 
 ///////////////////////////////////////////
 
+// owns the pool all of its nodes are allocated from
 struct Module : public AstNode
 {
-	std::vector<std::shared_ptr<Declaration>> declarations;
+	std::span<Declaration*> declarations;
+	std::unique_ptr<PoolAllocator> allocator;
 
-	Module(size_t begin, size_t end, std::vector<std::shared_ptr<Declaration>> declarations) : 
-		AstNode(begin, end), declarations(declarations) { }
+	Module(size_t begin, size_t end, std::span<Declaration*> declarations, std::unique_ptr<PoolAllocator> allocator) : 
+		AstNode(AstKind::Module, begin, end), declarations(declarations), allocator(std::move(allocator)) { }
 
 	IMPLEMENT_ACCEPT()
-};
\ No newline at end of file
+};
+///////////////////////////////////////////
+
+// visitor that dispatches on AstNode::kind with a switch instead of accept and a virtual visit.
+// Derived implements a visit overload for every node type it can reach
+template<typename Derived, typename Result = void>
+struct StaticAstVisitor
+{
+	Result dispatch(AstNode* node)
+	{
+		auto self = static_cast<Derived*>(this);
+		switch (node->kind)
+		{
+		case AstKind::IntegerExpression: return self->visit(static_cast<IntegerExpression*>(node));
+		case AstKind::IdentifierExpression: return self->visit(static_cast<IdentifierExpression*>(node));
+		case AstKind::UnaryExpression: return self->visit(static_cast<UnaryExpression*>(node));
+		case AstKind::BinaryExpression: return self->visit(static_cast<BinaryExpression*>(node));
+		case AstKind::CallExpression: return self->visit(static_cast<CallExpression*>(node));
+		case AstKind::IndexExpression: return self->visit(static_cast<IndexExpression*>(node));
+		case AstKind::BlockStatement: return self->visit(static_cast<BlockStatement*>(node));
+		case AstKind::VariableStatement: return self->visit(static_cast<VariableStatement*>(node));
+		case AstKind::ReturnStatement: return self->visit(static_cast<ReturnStatement*>(node));
+		case AstKind::WhileStatement: return self->visit(static_cast<WhileStatement*>(node));
+		case AstKind::IfStatement: return self->visit(static_cast<IfStatement*>(node));
+		case AstKind::FunctionDeclaration: return self->visit(static_cast<FunctionDeclaration*>(node));
+		case AstKind::Module: return self->visit(static_cast<Module*>(node));
+		}
+		throw std::exception("invalid node kind");
+	}
+};
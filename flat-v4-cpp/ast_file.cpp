@@ -0,0 +1,418 @@
+#include "ast_file.hpp"
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <unordered_map>
+#include <vector>
+
+static constexpr size_t SECTION_ALIGNMENT = 8;
+
+static_assert(sizeof(FlatTag) == 2 && sizeof(FlatSpan) == 8 && sizeof(FlatData) == 8, "ast file layout changed");
+static_assert(sizeof(AstFile::Header) == 56 && sizeof(AstFile::TypeEntry) == 8, "ast file layout changed");
+
+// collects the type table of the file. the types of the ast keep their index,
+// bases of pointer and array types that are not in the ast are appended after them
+struct TypeTableWriter
+{
+	std::vector<AstFile::TypeEntry> entries;
+	std::unordered_map<Type*, uint32_t> indices;
+
+	TypeTableWriter(std::vector<Type*> const& types) :
+		entries(types.size())
+	{
+		for (size_t i = 0; i < types.size(); i++)
+			indices.try_emplace(types[i], (uint32_t)i);
+		for (size_t i = 0; i < types.size(); i++)
+			entries[i] = describe(types[i]);
+	}
+
+	uint32_t getIndex(Type* type)
+	{
+		auto [it, inserted] = indices.try_emplace(type, (uint32_t)entries.size());
+		auto index = it->second;
+		if (inserted)
+		{
+			entries.push_back({});
+			entries[index] = describe(type);
+		}
+		return index;
+	}
+
+	AstFile::TypeEntry describe(Type* type)
+	{
+		using EntryKind = AstFile::TypeEntryKind;
+
+		if (!type)
+			return { EntryKind::None, 0 };
+
+		switch (type->kind)
+		{
+		case TypeKind::Builtin: return { EntryKind::Builtin, (uint32_t)static_cast<BuiltinType*>(type)->name };
+		case TypeKind::Named: return { EntryKind::Named, (uint32_t)static_cast<NamedType*>(type)->name };
+		case TypeKind::Struct: return { EntryKind::Struct, (uint32_t)static_cast<StructType*>(type)->name };
+		case TypeKind::Pointer: return { EntryKind::Pointer, getIndex(static_cast<PointerType*>(type)->base) };
+		case TypeKind::Array: return { EntryKind::Array, getIndex(static_cast<ArrayType*>(type)->base) };
+		}
+		throw std::exception("unknown type in ast");
+	}
+};
+
+template<typename T>
+static void writeSection(std::ostream& out, T const* values, size_t count)
+{
+	static char const padding[SECTION_ALIGNMENT] = {};
+	auto bytes = count * sizeof(T);
+	out.write((char const*)values, bytes);
+	out.write(padding, (SECTION_ALIGNMENT - bytes % SECTION_ALIGNMENT) % SECTION_ALIGNMENT);
+}
+
+void AstFile::write(FlatAst const& ast, std::string_view source, std::ostream& out)
+{
+	auto& interner = StringInterner::global();
+	auto symbolCount = interner.size();
+
+	std::vector<uint32_t> symbolOffsets = { 0 };
+	std::vector<char> symbolNames;
+	for (size_t i = 0; i < symbolCount; i++)
+	{
+		auto name = interner.name((Symbol)i);
+		symbolNames.insert(symbolNames.end(), name.begin(), name.end());
+		symbolOffsets.push_back((uint32_t)symbolNames.size());
+	}
+
+	TypeTableWriter types(ast.types);
+
+	Header header = {};
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.sourceLength = source.length();
+	header.sourceHash = hashSource(source);
+	header.root = ast.root;
+	header.nodeCount = (uint32_t)ast.size();
+	header.extraCount = (uint32_t)ast.extra.size();
+	header.literalCount = (uint32_t)ast.literals.size();
+	header.typeCount = (uint32_t)types.entries.size();
+	header.symbolCount = (uint32_t)symbolCount;
+	header.symbolBytes = (uint32_t)symbolNames.size();
+
+	writeSection(out, &header, 1);
+	writeSection(out, symbolOffsets.data(), symbolOffsets.size());
+	writeSection(out, symbolNames.data(), symbolNames.size());
+	writeSection(out, types.entries.data(), types.entries.size());
+	writeSection(out, ast.tags.data(), ast.tags.size());
+	writeSection(out, ast.spans.data(), ast.spans.size());
+	writeSection(out, ast.data.data(), ast.data.size());
+	writeSection(out, ast.extra.data(), ast.extra.size());
+	writeSection(out, ast.literals.data(), ast.literals.size());
+}
+
+// reads the sections of a mapped ast file and rebuilds the pointer ast from them. the flat nodes are
+// stored in post order, so a single forward pass finds the children of every node already built
+class AstFileReader
+{
+private:
+	std::string_view image;
+	size_t position;
+	TypeContext& ctx;
+
+	AstFile::Header header;
+	std::vector<Symbol> symbols;
+	std::vector<Type*> types;
+
+	std::span<FlatTag const> tags;
+	std::span<FlatSpan const> spans;
+	std::span<FlatData const> data;
+	std::span<uint32_t const> extra;
+	std::span<uint64_t const> literals;
+
+	std::unique_ptr<PoolAllocator> allocator;
+	std::vector<AstNode*> nodes;
+
+public:
+	AstFileReader(std::string_view image, TypeContext& ctx) :
+		image(image),
+		position(0),
+		ctx(ctx),
+		header(),
+		allocator(std::make_unique<PoolAllocator>())
+	{
+	}
+
+public:
+	bool readHeader(std::string_view source)
+	{
+		std::memcpy(&header, section<AstFile::Header>(1).data(), sizeof(header));
+		if (header.magic != AstFile::MAGIC || header.version != AstFile::VERSION)
+			fail();
+		return header.sourceLength == source.length() && header.sourceHash == AstFile::hashSource(source);
+	}
+
+	std::unique_ptr<Module> read()
+	{
+		auto symbolOffsets = section<uint32_t>((size_t)header.symbolCount + 1);
+		auto symbolNames = section<char>(header.symbolBytes);
+		symbols.reserve(header.symbolCount);
+		for (size_t i = 0; i < header.symbolCount; i++)
+		{
+			if (symbolOffsets[i] > symbolOffsets[i + 1] || symbolOffsets[i + 1] > symbolNames.size())
+				fail();
+			auto name = std::string_view(symbolNames.data() + symbolOffsets[i], symbolOffsets[i + 1] - symbolOffsets[i]);
+			symbols.push_back(StringInterner::global().intern(name));
+		}
+
+		auto typeEntries = section<AstFile::TypeEntry>(header.typeCount);
+		types.assign(header.typeCount, nullptr);
+		std::vector<uint8_t> state(header.typeCount, 0);
+		for (uint32_t i = 0; i < header.typeCount; i++)
+			resolveType(typeEntries, state, i);
+
+		tags = section<FlatTag>(header.nodeCount);
+		spans = section<FlatSpan>(header.nodeCount);
+		data = section<FlatData>(header.nodeCount);
+		extra = section<uint32_t>(header.extraCount);
+		literals = section<uint64_t>(header.literalCount);
+
+		nodes.reserve(header.nodeCount);
+		for (uint32_t i = 0; i < header.nodeCount; i++)
+			nodes.push_back(build(i));
+
+		if (header.root >= header.nodeCount || tags[header.root].kind != AstKind::Module)
+			fail();
+
+		auto module = static_cast<Module*>(nodes[header.root]);
+		return std::make_unique<Module>(module->begin, module->end, module->declarations, std::move(allocator));
+	}
+
+private:
+	[[noreturn]] void fail()
+	{
+		throw std::exception("invalid ast file");
+	}
+
+	template<typename T>
+	std::span<T const> section(size_t count)
+	{
+		auto bytes = count * sizeof(T);
+		if (image.length() - position < bytes)
+			fail();
+
+		auto values = std::span<T const>((T const*)(image.data() + position), count);
+		position += (bytes + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+		position = std::min(position, image.length());
+		return values;
+	}
+
+	// state is 0 for unvisited, 1 while the base of the type is resolved and 2 once it is done
+	void resolveType(std::span<AstFile::TypeEntry const> entries, std::vector<uint8_t>& state, uint32_t index)
+	{
+		using EntryKind = AstFile::TypeEntryKind;
+
+		if (index >= entries.size() || state[index] == 1)
+			fail();
+		if (state[index] == 2)
+			return;
+		state[index] = 1;
+
+		auto& entry = entries[index];
+		switch (entry.kind)
+		{
+		case EntryKind::None:
+			types[index] = nullptr;
+			break;
+		case EntryKind::Builtin:
+			types[index] = ctx.resolveNamedType(symbol(entry.operand));
+			break;
+		case EntryKind::Named:
+		case EntryKind::Struct:
+			types[index] = ctx.getNamedType(symbol(entry.operand));
+			break;
+		case EntryKind::Pointer:
+			resolveType(entries, state, entry.operand);
+			types[index] = ctx.getPointerType(types[entry.operand]);
+			break;
+		case EntryKind::Array:
+			resolveType(entries, state, entry.operand);
+			types[index] = ctx.getArrayType(types[entry.operand]);
+			break;
+		default:
+			fail();
+		}
+
+		if (entry.kind != EntryKind::None && !types[index])
+			fail();
+		state[index] = 2;
+	}
+
+	Symbol symbol(uint32_t index)
+	{
+		if (index >= symbols.size())
+			fail();
+		return symbols[index];
+	}
+
+	Type* type(uint32_t index)
+	{
+		if (index >= types.size())
+			fail();
+		return types[index];
+	}
+
+	std::span<uint32_t const> list(uint32_t index)
+	{
+		if (index >= extra.size() || extra[index] > extra.size() - index - 1)
+			fail();
+		return extra.subspan((size_t)index + 1, extra[index]);
+	}
+
+	// children always come before their parent, anything else would be a cycle
+	AstNode* child(uint32_t parent, uint32_t index, bool optional = false)
+	{
+		if (index == FlatAst::NONE && optional)
+			return nullptr;
+		if (index >= parent)
+			fail();
+		return nodes[index];
+	}
+
+	Expression* expression(uint32_t parent, uint32_t index)
+	{
+		auto node = child(parent, index);
+		if (tags[index].kind > AstKind::IndexExpression)
+			fail();
+		return static_cast<Expression*>(node);
+	}
+
+	Statement* statement(uint32_t parent, uint32_t index, bool optional = false)
+	{
+		auto node = child(parent, index, optional);
+		if (node && tags[index].kind > AstKind::IfStatement)
+			fail();
+		return static_cast<Statement*>(node);
+	}
+
+	template<typename T, typename Fn>
+	std::span<T> buildList(uint32_t index, Fn&& element)
+	{
+		auto elements = list(index);
+		if (elements.empty())
+			return {};
+
+		auto values = static_cast<T*>(allocator->allocate(elements.size() * sizeof(T), alignof(T)));
+		for (size_t i = 0; i < elements.size(); i++)
+			values[i] = element(elements[i]);
+		return std::span<T>(values, elements.size());
+	}
+
+	AstNode* build(uint32_t node)
+	{
+		size_t begin = spans[node].begin, end = spans[node].end;
+		auto [lhs, rhs] = data[node];
+		auto op = tags[node].op;
+
+		// the operator indexes the token and intrinsic tables and the span is used to slice the source
+		if ((size_t)op >= std::size(tokenNames) || begin > end || end > header.sourceLength)
+			fail();
+
+		switch (tags[node].kind)
+		{
+		case AstKind::IntegerExpression:
+			if (lhs >= literals.size())
+				fail();
+			return allocator->make<IntegerExpression>(begin, end, literals[lhs], (rhs == FlatAst::NONE) ? nullptr : type(rhs));
+
+		case AstKind::IdentifierExpression:
+			return allocator->make<IdentifierExpression>(begin, end, symbol(lhs));
+
+		case AstKind::UnaryExpression:
+			return allocator->make<UnaryExpression>(begin, end, op, expression(node, lhs));
+
+		case AstKind::BinaryExpression:
+			return allocator->make<BinaryExpression>(begin, end, op, expression(node, lhs), expression(node, rhs));
+
+		case AstKind::CallExpression:
+			return allocator->make<CallExpression>(begin, end, expression(node, lhs),
+				buildList<Expression*>(rhs, [&](uint32_t arg) { return expression(node, arg); }));
+
+		case AstKind::IndexExpression:
+			return allocator->make<IndexExpression>(begin, end, expression(node, lhs),
+				buildList<Expression*>(rhs, [&](uint32_t arg) { return expression(node, arg); }));
+
+		case AstKind::BlockStatement:
+			return allocator->make<BlockStatement>(begin, end,
+				buildList<Statement*>(lhs, [&](uint32_t element) { return statement(node, element); }));
+
+		case AstKind::VariableStatement:
+			return allocator->make<VariableStatement>(begin, end,
+				buildList<Symbol>(lhs, [&](uint32_t name) { return symbol(name); }),
+				buildList<Expression*>(rhs, [&](uint32_t value) { return expression(node, value); }));
+
+		case AstKind::ReturnStatement:
+			return allocator->make<ReturnStatement>(begin, end, expression(node, lhs));
+
+		case AstKind::WhileStatement:
+			return allocator->make<WhileStatement>(begin, end, expression(node, lhs), statement(node, rhs));
+
+		case AstKind::IfStatement:
+		{
+			auto bodies = list(rhs);
+			if (bodies.size() != 2)
+				fail();
+			return allocator->make<IfStatement>(begin, end, expression(node, lhs), statement(node, bodies[0]), statement(node, bodies[1], true));
+		}
+
+		case AstKind::FunctionDeclaration:
+		{
+			// body, result type and then (name, type) pairs of the parameters
+			auto elements = list(rhs);
+			if (elements.size() < 2 || elements.size() % 2 != 0)
+				fail();
+
+			std::vector<std::pair<Symbol, Type*>> parameters;
+			for (size_t i = 2; i < elements.size(); i += 2)
+				parameters.push_back({ symbol(elements[i]), type(elements[i + 1]) });
+
+			return allocator->make<FunctionDeclaration>(begin, end, symbol(lhs), type(elements[1]),
+				allocator->copy(parameters), statement(node, elements[0]));
+		}
+
+		case AstKind::Module:
+			return allocator->make<Module>(begin, end,
+				buildList<Declaration*>(lhs, [&](uint32_t declaration) {
+					if (child(node, declaration) && tags[declaration].kind != AstKind::FunctionDeclaration)
+						fail();
+					return static_cast<Declaration*>(nodes[declaration]);
+				}),
+				nullptr);
+
+		default:
+			fail();
+		}
+	}
+};
+
+std::unique_ptr<Module> AstFile::load(std::string_view image, std::string_view source, TypeContext& ctx)
+{
+	AstFileReader reader(image, ctx);
+	if (!reader.readHeader(source))
+		return nullptr;
+	return reader.read();
+}
+
+// FNV-1a over 64 bit words, only used to tell whether the source changed since the file was written
+uint64_t AstFile::hashSource(std::string_view source)
+{
+	constexpr uint64_t prime = 0x100000001b3;
+	uint64_t hash = 0xcbf29ce484222325;
+
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= source.length(); i += sizeof(uint64_t))
+	{
+		uint64_t word;
+		std::memcpy(&word, source.data() + i, sizeof(word));
+		hash = (hash ^ word) * prime;
+	}
+	for (; i < source.length(); i++)
+		hash = (hash ^ (uint8_t)source[i]) * prime;
+
+	return hash;
+}
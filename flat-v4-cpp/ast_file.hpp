@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string_view>
+
+#include "flat_ast.hpp"
+
+// binary image of a FlatAst, laid out so it can be read straight from a memory mapped file:
+//   header, symbol name offsets, symbol names, types, tags, spans, data, extra, literals
+// every section starts 8 byte aligned. symbols and types are indices into the tables of the file,
+// so a module can be loaded into a process with a different interner and type context
+class AstFile
+{
+public:
+	static constexpr uint32_t MAGIC = 0x74736166; // "fast"
+	static constexpr uint32_t VERSION = 2;
+
+	enum class TypeEntryKind : uint32_t
+	{
+		None,
+		Builtin,
+		Named,
+		Struct,
+		Pointer,
+		Array,
+	};
+
+	// operand is the symbol of the name or the type index of the base
+	struct TypeEntry
+	{
+		TypeEntryKind kind;
+		uint32_t operand;
+	};
+
+	struct Header
+	{
+		uint32_t magic, version;
+		uint64_t sourceLength, sourceHash;
+		uint32_t root;
+		uint32_t nodeCount, extraCount, literalCount;
+		uint32_t typeCount, symbolCount, symbolBytes;
+		uint32_t reserved;
+	};
+
+public:
+	static void write(FlatAst const& ast, std::string_view source, std::ostream& out);
+
+	// rebuilds the module without lexing or parsing. identifier names are interned, so the image can be unmapped afterwards.
+	// returns nullptr if the image was written for a different source, throws if it is not a valid ast file
+	static std::unique_ptr<Module> load(std::string_view image, std::string_view source, TypeContext& ctx);
+
+	static uint64_t hashSource(std::string_view source);
+};
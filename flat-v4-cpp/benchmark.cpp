@@ -0,0 +1,381 @@
+#include "benchmark.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "flat_ast.hpp"
+#include "scan.hpp"
+#include "memory_stats.hpp"
+#include "thread_pool.hpp"
+#include "ast_file.hpp"
+#include "semantic_pass.hpp"
+#include "constant_folding.hpp"
+#include "ir_builder.hpp"
+#include "register_allocator.hpp"
+#include "instruction_selector.hpp"
+#include "peephole_optimizer.hpp"
+#include "executable_memory.hpp"
+
+#include <sstream>
+#include <type_traits>
+
+// the generated code follows the win64 convention on every platform
+#ifdef _WIN32
+using BenchFunction = int64_t(*)(int64_t);
+#else
+using BenchFunction = int64_t(__attribute__((ms_abi))*)(int64_t);
+#endif
+
+static constexpr int64_t BENCH_ARGUMENT = 100000;
+
+// counts the nodes of a tree, either through accept and the virtual visit overloads of AstVisitor
+// or through the kind switch of StaticAstVisitor. the visit overloads are shared by both
+template<bool Static>
+struct NodeCounter : public std::conditional_t<Static, StaticAstVisitor<NodeCounter<Static>>, AstVisitor>
+{
+	size_t count = 0;
+
+	void walk(AstNode* node)
+	{
+		if (!node)
+			return;
+		if constexpr (Static)
+			this->dispatch(node);
+		else
+			AstVisitor::visit(node);
+	}
+
+	template<typename T>
+	void walk(std::span<T*> nodes)
+	{
+		for (auto node : nodes)
+			walk(node);
+	}
+
+	void visit(IntegerExpression*) { count++; }
+	void visit(IdentifierExpression*) { count++; }
+	void visit(UnaryExpression* node) { count++; walk(node->expression); }
+	void visit(BinaryExpression* node) { count++; walk(node->left); walk(node->right); }
+	void visit(CallExpression* node) { count++; walk(node->expression); walk(node->args); }
+	void visit(IndexExpression* node) { count++; walk(node->expression); walk(node->args); }
+	void visit(BlockStatement* node) { count++; walk(node->statements); }
+	void visit(VariableStatement* node) { count++; walk(node->values); }
+	void visit(ReturnStatement* node) { count++; walk(node->expression); }
+	void visit(WhileStatement* node) { count++; walk(node->condition); walk(node->body); }
+	void visit(IfStatement* node) { count++; walk(node->condition); walk(node->ifBody); walk(node->elseBody); }
+	void visit(FunctionDeclaration* node) { count++; walk(node->body); }
+	void visit(Module* node) { count++; walk(node->declarations); }
+};
+
+void Benchmark::run()
+{
+	runLexer();
+	runScanKernels();
+	runTokenizer();
+	runParser();
+	runParallelParser();
+	runFlatAst();
+	runAstFile();
+	runDispatch();
+	runSemanticPass();
+	runCompiledCode();
+}
+
+void Benchmark::runLexer()
+{
+	SourceFile source(input);
+	DiagnosticEngine diagnostics(source, logStream);
+
+	size_t tokens = 0;
+	auto seconds = measure([&] {
+		Lexer lexer(source, diagnostics);
+		tokens = 0;
+		while (lexer.next() != Token::Eof)
+			tokens++;
+	});
+
+	report("lexer", seconds, tokens, "tokens");
+}
+
+void Benchmark::runScanKernels()
+{
+	SourceFile source(input);
+	DiagnosticEngine diagnostics(source, logStream);
+
+	auto best = scan::getBestKernel();
+	for (size_t kernel = 0; kernel <= (size_t)best; kernel++)
+	{
+		scan::selectKernel((scan::Kernel)kernel);
+
+		size_t tokens = 0;
+		auto seconds = measure([&] {
+			Lexer lexer(source, diagnostics);
+			tokens = 0;
+			while (lexer.next() != Token::Eof)
+				tokens++;
+		});
+
+		report(std::string("lexer[") + scan::kernelNames[kernel] + "]", seconds, tokens, "tokens");
+	}
+
+	scan::selectKernel(best);
+}
+
+void Benchmark::runTokenizer()
+{
+	SourceFile source(input);
+	DiagnosticEngine diagnostics(source, logStream);
+
+	size_t tokens = 0;
+	auto seconds = measure([&] {
+		Lexer lexer(source, diagnostics);
+		lexer.tokenize();
+		tokens = 0;
+		while (lexer.peek() != Token::Eof)
+		{
+			lexer.match(lexer.peek());
+			tokens++;
+		}
+	});
+
+	report("tokenizer", seconds, tokens, "tokens");
+}
+
+void Benchmark::runParser()
+{
+	SourceFile source(input);
+	DiagnosticEngine diagnostics(source, logStream);
+
+	size_t declarations = 0;
+	auto seconds = measure([&] {
+		TypeContext ctx(64);
+		Parser parser(ctx, source, diagnostics);
+		declarations = parser.module()->declarations.size();
+	});
+
+	report("parser", seconds, declarations, "declarations");
+
+	auto allocations = memory::getAllocationCount();
+	size_t poolBytes = 0;
+	{
+		TypeContext ctx(64);
+		Parser parser(ctx, source, diagnostics);
+		poolBytes = parser.module()->allocator->getAllocatedBytes();
+	}
+	logStream << "parser: ";
+	if (memory::countsAllocations)
+		logStream << memory::getAllocationCount() - allocations << " allocations per run, ";
+	logStream << poolBytes / 1e6 << " MB of nodes, " << memory::getPeakResidentBytes() / 1e6 << " MB peak resident\n";
+}
+
+void Benchmark::runParallelParser()
+{
+	SourceFile source(input);
+	DiagnosticEngine diagnostics(source, logStream);
+	ThreadPool pool(ThreadPool::getDefaultThreadCount());
+
+	size_t declarations = 0;
+	auto seconds = measure([&] {
+		TypeContext ctx(64);
+		Parser parser(ctx, source, diagnostics);
+		declarations = parser.module(pool)->declarations.size();
+	});
+
+	report("parser[" + std::to_string(pool.size()) + " threads]", seconds, declarations, "declarations");
+}
+
+void Benchmark::runFlatAst()
+{
+	SourceFile source(input);
+	DiagnosticEngine diagnostics(source, logStream);
+
+	TypeContext ctx(64);
+	Parser parser(ctx, source, diagnostics);
+	auto module = parser.module();
+
+	FlatAst ast;
+	auto seconds = measure([&] {
+		ast = FlatAst::build(module.get());
+	});
+
+	report("flat ast", seconds, ast.size(), "nodes");
+	logStream << "flat ast: " << (double)ast.getMemoryUsage() / ast.size() << " bytes per node, pointer ast: "
+		<< (double)module->allocator->getAllocatedBytes() / ast.size() << " bytes per node\n";
+}
+
+void Benchmark::runAstFile()
+{
+	SourceFile source(input);
+	DiagnosticEngine diagnostics(source, logStream);
+
+	TypeContext ctx(64);
+	Parser parser(ctx, source, diagnostics);
+	auto module = parser.module();
+
+	std::ostringstream out;
+	AstFile::write(FlatAst::build(module.get()), input, out);
+	auto image = out.str();
+
+	size_t declarations = 0;
+	auto seconds = measure([&] {
+		TypeContext ctx(64);
+		declarations = AstFile::load(image, input, ctx)->declarations.size();
+	});
+
+	report("ast file load", seconds, declarations, "declarations");
+	logStream << "ast file: " << image.length() / 1e6 << " MB\n";
+}
+
+void Benchmark::runDispatch()
+{
+	SourceFile source(input);
+	DiagnosticEngine diagnostics(source, logStream);
+
+	TypeContext ctx(64);
+	Parser parser(ctx, source, diagnostics);
+	auto module = parser.module();
+
+	size_t nodes = 0;
+	auto virtualSeconds = measure([&] {
+		NodeCounter<false> counter;
+		counter.walk(module.get());
+		nodes = counter.count;
+	});
+	report("dispatch[virtual]", virtualSeconds, nodes, "nodes");
+
+	auto staticSeconds = measure([&] {
+		NodeCounter<true> counter;
+		counter.walk(module.get());
+		nodes = counter.count;
+	});
+	report("dispatch[static]", staticSeconds, nodes, "nodes");
+}
+
+void Benchmark::runSemanticPass()
+{
+	SourceFile source(input);
+	DiagnosticEngine diagnostics(source, logStream);
+	ThreadPool pool(ThreadPool::getDefaultThreadCount());
+
+	TypeContext ctx(64);
+	ctx.addBuiltinTypes();
+	Parser parser(ctx, source, diagnostics);
+	auto module = parser.module();
+	ctx.resolveTypes();
+
+	FunctionTable functions;
+	DiagnosticEngine extractDiagnostics(source, logStream);
+	SemanticValidationPass(ctx, extractDiagnostics, functions).extractFunctions(module.get());
+
+	size_t errors = 0;
+	auto seconds = measure([&] {
+		DiagnosticEngine diagnostics(source, logStream);
+		SemanticValidationPass(ctx, diagnostics, functions).validateFunctions();
+		errors = diagnostics.getErrorCount();
+	});
+	report("semantic pass", seconds, functions.size(), "functions");
+
+	auto parallelSeconds = measure([&] {
+		DiagnosticEngine diagnostics(source, logStream);
+		SemanticValidationPass(ctx, diagnostics, functions).validateFunctions(pool);
+		errors = diagnostics.getErrorCount();
+	});
+	report("semantic pass[" + std::to_string(pool.size()) + " threads]", parallelSeconds, functions.size(), "functions");
+	logStream << "semantic pass: " << errors << " error(s)\n";
+}
+
+// compiles the input and runs its bench(n: i64): i64 function, once with every value in a spill slot, once with
+// the values in the registers the allocator picked and once more with the peephole optimizer on top. the spilled
+// run goes through the same instruction selector, it is not the push/pop stack machine the allocator replaced
+void Benchmark::runCompiledCode()
+{
+	SourceFile source(input);
+	DiagnosticEngine diagnostics(source, logStream);
+
+	TypeContext ctx(64);
+	ctx.addBuiltinTypes();
+	Parser parser(ctx, source, diagnostics);
+	auto module = parser.module();
+	ctx.resolveTypes();
+
+	FunctionTable functions;
+	SemanticValidationPass pass(ctx, diagnostics, functions);
+	pass.extractFunctions(module.get());
+	pass.validateFunctions();
+	if (diagnostics.hasErrors())
+	{
+		logStream << "compiled code: the input has errors\n";
+		return;
+	}
+
+	ConstantFoldingPass(*module->allocator).dispatch(module.get());
+	functions.assignLinkNames();
+
+	TypeId parameters[] = { ctx.getNamedType("i64")->getResolvedType()->id };
+	auto bench = functions.find(StringInterner::global().intern("bench"), parameters);
+	if (bench == FunctionTable::NONE)
+	{
+		logStream << "compiled code: the input has no fn bench(n: i64): i64\n";
+		return;
+	}
+
+	try
+	{
+		IrBuilder builder;
+		std::vector<IrFunction> ir;
+		for (auto function : functions.getFunctions())
+			ir.push_back(builder.build(function));
+
+		struct Configuration
+		{
+			const char* name;
+			bool allocate, optimize;
+		};
+
+		Configuration configurations[] = { { "spilled", false, false }, { "registers", true, false }, { "peephole", true, true } };
+		for (auto [name, allocate, optimize] : configurations)
+		{
+			RegisterAllocator allocator(allocate ? std::span<uint8_t const>(RegisterAllocator::registers) : std::span<uint8_t const>());
+			std::vector<RegisterAllocation> allocations;
+			for (auto& function : ir)
+				allocations.push_back(allocator.allocate(function));
+
+			Linker linker;
+			CodeGenerator codeGen(linker);
+			PeepholeOptimizer peephole;
+			InstructionSelector selector(linker, codeGen, optimize ? &peephole : nullptr);
+			for (auto layoutPass : { true, false })
+			{
+				linker.beginPass(layoutPass);
+				peephole.resetCounts();
+				for (size_t i = 0; i < ir.size(); i++)
+					selector.select(ir[i], allocations[i]);
+			}
+
+			ExecutableMemory code(linker.getData().data(), linker.getData().size());
+			auto function = code.get<BenchFunction>(linker.getSymbol(functions.get(bench)->linkName));
+
+			int64_t result = 0;
+			auto seconds = measure([&] {
+				result = function(BENCH_ARGUMENT);
+			});
+
+			size_t rewrites = 0;
+			for (size_t i = 0; i < (size_t)PeepholeRule::Count; i++)
+				rewrites += peephole.getCount((PeepholeRule)i);
+
+			logStream << "compiled code[" << name << "]: bench(" << BENCH_ARGUMENT << ") = " << result
+				<< " in " << seconds * 1000 << " ms, " << linker.getData().size() << " bytes of code, " << allocator.getSpilled()
+				<< " values spilled, " << rewrites << " peephole rewrites (best of " << std::max<size_t>(iterations, 1) << ")\n";
+		}
+	}
+	catch (std::exception& e)
+	{
+		logStream << "compiled code: " << e.what() << "\n";
+	}
+}
+
+void Benchmark::report(std::string const& name, double seconds, size_t count, std::string const& unit)
+{
+	auto megabytes = input.length() / 1e6;
+	logStream << name << ": " << count << " " << unit << ", " << megabytes << " MB in " << seconds * 1000 << " ms, "
+		<< megabytes / seconds << " MB/s (best of " << std::max<size_t>(iterations, 1) << ")\n";
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <iostream>
+
+class Benchmark
+{
+private:
+	std::string_view input;
+	size_t iterations;
+	std::ostream& logStream;
+
+public:
+	Benchmark(std::string_view input, size_t iterations, std::ostream& logStream) :
+		input(input),
+		iterations(iterations),
+		logStream(logStream)
+	{
+	}
+
+public:
+	void run();
+	void runLexer();
+	void runScanKernels();
+	void runTokenizer();
+	void runParser();
+	void runParallelParser();
+	void runFlatAst();
+	void runAstFile();
+	void runDispatch();
+	void runSemanticPass();
+	void runCompiledCode();
+
+private:
+	// runs fn the configured number of times and returns the best time in seconds
+	template<typename Fn>
+	double measure(Fn&& fn)
+	{
+		double best = 0;
+		for (size_t i = 0; i < std::max<size_t>(iterations, 1); i++)
+		{
+			auto begin = std::chrono::steady_clock::now();
+			fn();
+			auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+			if (i == 0 || seconds < best)
+				best = seconds;
+		}
+		return best;
+	}
+
+	void report(std::string const& name, double seconds, size_t count, std::string const& unit);
+};
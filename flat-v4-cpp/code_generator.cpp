@@ -47,6 +47,70 @@ void CodeGenerator::generateEpilog(size_t numParameters, size_t stackSpace)
 	emitReturn();
 }
 
+void CodeGenerator::emit(MachineInstruction const& instruction)
+{
+	auto reg1 = instruction.reg1, reg2 = instruction.reg2;
+	switch (instruction.op)
+	{
+	case MachineOp::Label: ctx.symbol(instruction.label); break;
+
+	case MachineOp::Push: emitPush(reg1); break;
+	case MachineOp::Pop: emitPop(reg1); break;
+
+	case MachineOp::AddRIm32: emitAddRIm32(reg1, (uint32_t)instruction.immediate); break;
+	case MachineOp::AddRR: emitAddRR(reg1, reg2); break;
+	case MachineOp::SubRIm32: emitSubRIm32(reg1, (uint32_t)instruction.immediate); break;
+	case MachineOp::SubRR: emitSubRR(reg1, reg2); break;
+	case MachineOp::IMulRR: emitIMulRR(reg1, reg2); break;
+	case MachineOp::DivR: emitDivR(reg1); break;
+	case MachineOp::IDivR: emitIDivR(reg1); break;
+	case MachineOp::Cqo: emitCqo(); break;
+
+	case MachineOp::NegR: emitNegR(reg1); break;
+	case MachineOp::NotR: emitNotR(reg1); break;
+	case MachineOp::AndRR: emitAndRR(reg1, reg2); break;
+	case MachineOp::OrRR: emitOrRR(reg1, reg2); break;
+	case MachineOp::XorRR: emitXorRR(reg1, reg2); break;
+
+	case MachineOp::ShlRCl: emitShlRCl(reg1); break;
+	case MachineOp::ShrRCl: emitShrRCl(reg1); break;
+	case MachineOp::SarRCl: emitSarRCl(reg1); break;
+	case MachineOp::ShlRIm8: emitShlRIm8(reg1, (uint8_t)instruction.immediate); break;
+	case MachineOp::ShrRIm8: emitShrRIm8(reg1, (uint8_t)instruction.immediate); break;
+	case MachineOp::SarRIm8: emitSarRIm8(reg1, (uint8_t)instruction.immediate); break;
+
+	case MachineOp::CmpRR: emitCmpRR(reg1, reg2); break;
+	case MachineOp::TestRR: emitTestRR(reg1, reg2); break;
+	case MachineOp::SetCC: emitSetCC(instruction.condition, reg1); break;
+
+	case MachineOp::MovRR: emitMovRR(reg1, reg2); break;
+	case MachineOp::MovRIm64: emitMovRIm64(reg1, (uint64_t)instruction.immediate); break;
+	case MachineOp::MovRIm32: emitMovRIm32(reg1, (int32_t)instruction.immediate); break;
+	case MachineOp::MovR32Im32: emitMovR32Im32(reg1, (uint32_t)instruction.immediate); break;
+	case MachineOp::MovRel8R: emitMovRel8R(reg1, (int8_t)instruction.immediate, reg2); break;
+	case MachineOp::MovRel32R: emitMovRel32R(reg1, (int32_t)instruction.immediate, reg2); break;
+	case MachineOp::MovRRel32: emitMovRRel32(reg1, reg2, (int32_t)instruction.immediate); break;
+
+	case MachineOp::Movzx8RRel32: emitMovzx8RRel32(reg1, reg2, (int32_t)instruction.immediate); break;
+	case MachineOp::Movsx8RRel32: emitMovsx8RRel32(reg1, reg2, (int32_t)instruction.immediate); break;
+	case MachineOp::Movzx16RRel32: emitMovzx16RRel32(reg1, reg2, (int32_t)instruction.immediate); break;
+	case MachineOp::Movsx16RRel32: emitMovsx16RRel32(reg1, reg2, (int32_t)instruction.immediate); break;
+	case MachineOp::MovR32Rel32: emitMovR32Rel32(reg1, reg2, (int32_t)instruction.immediate); break;
+	case MachineOp::Movsx32RRel32: emitMovsx32RRel32(reg1, reg2, (int32_t)instruction.immediate); break;
+	case MachineOp::MovRel32R8: emitMovRel32R8(reg1, (int32_t)instruction.immediate, reg2); break;
+	case MachineOp::MovRel32R16: emitMovRel32R16(reg1, (int32_t)instruction.immediate, reg2); break;
+	case MachineOp::MovRel32R32: emitMovRel32R32(reg1, (int32_t)instruction.immediate, reg2); break;
+
+	case MachineOp::CallRipRel32: emitCallRipRel32(ctx.getSymbol(instruction.label)); break;
+	case MachineOp::Jmp: emitJmp(ctx.getSymbol(instruction.label)); break;
+	case MachineOp::JmpCC: emitJmpCC(instruction.condition, ctx.getSymbol(instruction.label)); break;
+	case MachineOp::Return: emitReturn(); break;
+
+	default:
+		throw std::exception("invalid machine instruction");
+	}
+}
+
 uint8_t CodeGenerator::modRm(uint8_t mod, uint8_t reg, uint8_t rm)
 {
 	return (uint8_t)(((mod & 0x03) << 6) | ((reg & 0x07) << 3) | ((rm & 0x07) << 0));
@@ -64,42 +128,52 @@ uint8_t CodeGenerator::rex(uint8_t w, uint8_t reg, uint8_t idx, uint8_t rm)
 
 void CodeGenerator::emitPush(uint8_t reg)
 {
-	ctx << rex(1, reg, 0, 0) << (uint8_t)(0x50 | (reg & 0x07));
+	ctx << rex(1, 0, 0, reg) << (uint8_t)(0x50 | (reg & 0x07));
 }
 
 void CodeGenerator::emitPop(uint8_t reg)
 {
-	ctx << rex(1, reg, 0, 0) << (uint8_t)(0x58 | (reg & 0x07));
+	ctx << rex(1, 0, 0, reg) << (uint8_t)(0x58 | (reg & 0x07));
+}
+
+void CodeGenerator::emitPushIm8(int8_t value)
+{
+	ctx << 0x6Auss << value;
+}
+
+void CodeGenerator::emitPushIm32(int32_t value)
+{
+	ctx << 0x68uss << value;
 }
 
 void CodeGenerator::emitAddRIm8(uint8_t reg, uint8_t value)
 {
-	ctx << rex(1, reg, 0, 0) << 0x83uss << modRm(0x03, 0x00, reg) << value;
+	ctx << rex(1, 0, 0, reg) << 0x83uss << modRm(0x03, 0x00, reg) << value;
 }
 
 void CodeGenerator::emitAddRIm32(uint8_t reg, uint32_t value)
 {
-	ctx << rex(1, reg, 0, 0) << 0x81uss << modRm(0x03, 0x00, reg) << value;
+	ctx << rex(1, 0, 0, reg) << 0x81uss << modRm(0x03, 0x00, reg) << value;
 }
 
 void CodeGenerator::emitAddRR(uint8_t reg1, uint8_t reg2)
 {
-	ctx << rex(1, reg1, 0, reg2) << 0x01uss << modRm(0x03, reg1, reg2);
+	ctx << rex(1, reg1, 0, reg2) << 0x03uss << modRm(0x03, reg1, reg2);
 }
 
 void CodeGenerator::emitSubRIm8(uint8_t reg, uint8_t value)
 {
-	ctx << rex(1, reg, 0, 0) << 0x83uss << modRm(0x03, 0x05, reg) << value;
+	ctx << rex(1, 0, 0, reg) << 0x83uss << modRm(0x03, 0x05, reg) << value;
 }
 
 void CodeGenerator::emitSubRIm32(uint8_t reg, uint32_t value)
 {
-	ctx << rex(1, reg, 0, 0) << 0x81uss << modRm(0x03, 0x05, reg) << value;
+	ctx << rex(1, 0, 0, reg) << 0x81uss << modRm(0x03, 0x05, reg) << value;
 }
 
 void CodeGenerator::emitSubRR(uint8_t reg1, uint8_t reg2)
 {
-	ctx << rex(1, reg1, 0, reg2) << 0x29uss << modRm(0x03, reg1, reg2);
+	ctx << rex(1, reg1, 0, reg2) << 0x2Buss << modRm(0x03, reg1, reg2);
 }
 
 void CodeGenerator::emitMulR(uint8_t reg)
@@ -117,11 +191,21 @@ void CodeGenerator::emitIMulR(uint8_t reg)
 	ctx << rex(1, 0, 0, reg) << 0xF7uss << modRm(0x03, 0x05, reg);
 }
 
+void CodeGenerator::emitIMulRR(uint8_t reg1, uint8_t reg2)
+{
+	ctx << rex(1, reg1, 0, reg2) << 0x0Fuss << 0xAFuss << modRm(0x03, reg1, reg2);
+}
+
 void CodeGenerator::emitIDivR(uint8_t reg)
 {
 	ctx << rex(1, 0, 0, reg) << 0xF7uss << modRm(0x03, 0x07, reg);
 }
 
+void CodeGenerator::emitCqo()
+{
+	ctx << rex(1, 0, 0, 0) << 0x99uss;
+}
+
 void CodeGenerator::emitNegR(uint8_t reg)
 {
 	ctx << rex(1, 0, 0, reg) << 0xF7uss << modRm(0x03, 0x03, reg);
@@ -139,17 +223,30 @@ void CodeGenerator::emitTestRR(uint8_t reg1, uint8_t reg2)
 
 void CodeGenerator::emitCmpRR(uint8_t reg1, uint8_t reg2)
 {
-	ctx << rex(1, reg1, 0, reg2) << 0x39ss << modRm(0x03, reg1, reg2);
+	ctx << rex(1, reg1, 0, reg2) << 0x3Buss << modRm(0x03, reg1, reg2);
 }
 
 void CodeGenerator::emitMovRR(uint8_t reg1, uint8_t reg2)
 {
-	ctx << rex(1, reg1, 0, reg2) << 0x89uss << modRm(0x11, reg1, reg2);
+	ctx << rex(1, reg1, 0, reg2) << 0x8Buss << modRm(0x03, reg1, reg2);
 }
 
 void CodeGenerator::emitMovRIm64(uint8_t reg, uint64_t value)
 {
-	ctx << rex(1, reg, 0, 0) << (uint8_t)(0xB8uss | (reg & 0x07)) << value;
+	ctx << rex(1, 0, 0, reg) << (uint8_t)(0xB8uss | (reg & 0x07)) << value;
+}
+
+void CodeGenerator::emitMovRIm32(uint8_t reg, int32_t value)
+{
+	ctx << rex(1, 0, 0, reg) << 0xC7uss << modRm(0x03, 0x00, reg) << value;
+}
+
+void CodeGenerator::emitMovR32Im32(uint8_t reg, uint32_t value)
+{
+	// writing the low half zero extends, the prefix is only needed for r8 and up
+	if (reg & 0x08)
+		ctx << rex(0, 0, 0, reg);
+	ctx << (uint8_t)(0xB8uss | (reg & 0x07)) << value;
 }
 
 void CodeGenerator::emitMovRel8R(uint8_t reg1, int8_t offset, uint8_t reg2)
@@ -164,12 +261,59 @@ void CodeGenerator::emitMovRel32R(uint8_t reg1, int32_t offset, uint8_t reg2)
 
 void CodeGenerator::emitMovRRel8(uint8_t reg1, uint8_t reg2, int8_t offset)
 {
-	ctx << rex(1, reg1, 0, 0) << 0x8Buss << modRm(0x01, reg1, 0x04) << sib(0x00, 0x04, reg2) << offset;
+	ctx << rex(1, reg1, 0, reg2) << 0x8Buss << modRm(0x01, reg1, 0x04) << sib(0x00, 0x04, reg2) << offset;
 }
 
 void CodeGenerator::emitMovRRel32(uint8_t reg1, uint8_t reg2, int32_t offset)
 {
-	ctx << rex(1, reg1, 0, 0) << 0x8Buss << modRm(0x02, reg2, 0x04) << sib(0x00, 0x04, reg2) << offset;
+	ctx << rex(1, reg1, 0, reg2) << 0x8Buss << modRm(0x02, reg1, 0x04) << sib(0x00, 0x04, reg2) << offset;
+}
+
+void CodeGenerator::emitMovzx8RRel32(uint8_t reg1, uint8_t reg2, int32_t offset)
+{
+	ctx << rex(1, reg1, 0, reg2) << 0x0Fuss << 0xB6uss << modRm(0x02, reg1, 0x04) << sib(0x00, 0x04, reg2) << offset;
+}
+
+void CodeGenerator::emitMovsx8RRel32(uint8_t reg1, uint8_t reg2, int32_t offset)
+{
+	ctx << rex(1, reg1, 0, reg2) << 0x0Fuss << 0xBEuss << modRm(0x02, reg1, 0x04) << sib(0x00, 0x04, reg2) << offset;
+}
+
+void CodeGenerator::emitMovzx16RRel32(uint8_t reg1, uint8_t reg2, int32_t offset)
+{
+	ctx << rex(1, reg1, 0, reg2) << 0x0Fuss << 0xB7uss << modRm(0x02, reg1, 0x04) << sib(0x00, 0x04, reg2) << offset;
+}
+
+void CodeGenerator::emitMovsx16RRel32(uint8_t reg1, uint8_t reg2, int32_t offset)
+{
+	ctx << rex(1, reg1, 0, reg2) << 0x0Fuss << 0xBFuss << modRm(0x02, reg1, 0x04) << sib(0x00, 0x04, reg2) << offset;
+}
+
+void CodeGenerator::emitMovR32Rel32(uint8_t reg1, uint8_t reg2, int32_t offset)
+{
+	// writing the low half zero extends
+	ctx << rex(0, reg1, 0, reg2) << 0x8Buss << modRm(0x02, reg1, 0x04) << sib(0x00, 0x04, reg2) << offset;
+}
+
+void CodeGenerator::emitMovsx32RRel32(uint8_t reg1, uint8_t reg2, int32_t offset)
+{
+	ctx << rex(1, reg1, 0, reg2) << 0x63uss << modRm(0x02, reg1, 0x04) << sib(0x00, 0x04, reg2) << offset;
+}
+
+void CodeGenerator::emitMovRel32R8(uint8_t reg1, int32_t offset, uint8_t reg2)
+{
+	// without the prefix the low bytes of RSP, RBP, RSI and RDI would encode AH, CH, DH and BH
+	ctx << rex(0, reg2, 0, reg1) << 0x88uss << modRm(0x02, reg2, 0x04) << sib(0x00, 0x04, reg1) << offset;
+}
+
+void CodeGenerator::emitMovRel32R16(uint8_t reg1, int32_t offset, uint8_t reg2)
+{
+	ctx << 0x66uss << rex(0, reg2, 0, reg1) << 0x89uss << modRm(0x02, reg2, 0x04) << sib(0x00, 0x04, reg1) << offset;
+}
+
+void CodeGenerator::emitMovRel32R32(uint8_t reg1, int32_t offset, uint8_t reg2)
+{
+	ctx << rex(0, reg2, 0, reg1) << 0x89uss << modRm(0x02, reg2, 0x04) << sib(0x00, 0x04, reg1) << offset;
 }
 
 void CodeGenerator::emitAndRR(uint8_t reg1, uint8_t reg2)
@@ -199,12 +343,32 @@ void CodeGenerator::emitXorRIm32(uint8_t reg, uint32_t value)
 
 void CodeGenerator::emitShlRCl(uint8_t reg)
 {
-	ctx << rex(1, 0, 0, reg) << 0xD3 << modRm(0x03, 0x04, reg);
+	ctx << rex(1, 0, 0, reg) << 0xD3uss << modRm(0x03, 0x04, reg);
 }
 
 void CodeGenerator::emitShrRCl(uint8_t reg)
 {
-	ctx << rex(1, 0, 0, reg) << 0xD3 << modRm(0x03, 0x05, reg);
+	ctx << rex(1, 0, 0, reg) << 0xD3uss << modRm(0x03, 0x05, reg);
+}
+
+void CodeGenerator::emitSarRCl(uint8_t reg)
+{
+	ctx << rex(1, 0, 0, reg) << 0xD3uss << modRm(0x03, 0x07, reg);
+}
+
+void CodeGenerator::emitShlRIm8(uint8_t reg, uint8_t value)
+{
+	ctx << rex(1, 0, 0, reg) << 0xC1uss << modRm(0x03, 0x04, reg) << value;
+}
+
+void CodeGenerator::emitShrRIm8(uint8_t reg, uint8_t value)
+{
+	ctx << rex(1, 0, 0, reg) << 0xC1uss << modRm(0x03, 0x05, reg) << value;
+}
+
+void CodeGenerator::emitSarRIm8(uint8_t reg, uint8_t value)
+{
+	ctx << rex(1, 0, 0, reg) << 0xC1uss << modRm(0x03, 0x07, reg) << value;
 }
 
 void CodeGenerator::emitSetE(uint8_t reg)
@@ -237,6 +401,31 @@ void CodeGenerator::emitSetGe(uint8_t reg)
 	ctx << 0x0Fuss << 0x9Duss << modRm(0x03, 0, reg);
 }
 
+void CodeGenerator::emitSetB(uint8_t reg)
+{
+	ctx << 0x0Fuss << 0x92uss << modRm(0x03, 0, reg);
+}
+
+void CodeGenerator::emitSetA(uint8_t reg)
+{
+	ctx << 0x0Fuss << 0x97uss << modRm(0x03, 0, reg);
+}
+
+void CodeGenerator::emitSetBe(uint8_t reg)
+{
+	ctx << 0x0Fuss << 0x96uss << modRm(0x03, 0, reg);
+}
+
+void CodeGenerator::emitSetAe(uint8_t reg)
+{
+	ctx << 0x0Fuss << 0x93uss << modRm(0x03, 0, reg);
+}
+
+void CodeGenerator::emitSetCC(x64::Condition condition, uint8_t reg)
+{
+	ctx << 0x0Fuss << (uint8_t)(0x90uss | condition) << modRm(0x03, 0, reg);
+}
+
 void CodeGenerator::emitLeaRRipRel32(uint8_t reg, size_t address)
 {
 	ctx << rex(1, reg, 0, 0) << 0x8Duss << modRm(0x00, reg, 0x05) << (int32_t)(address - (ctx.getCurrentAddress() + 4));
@@ -267,6 +456,11 @@ void CodeGenerator::emitJmpNZ(size_t address)
 	ctx << 0x0Fuss << 0x85uss << (int32_t)(address - (ctx.getCurrentAddress() + 4));
 }
 
+void CodeGenerator::emitJmpCC(x64::Condition condition, size_t address)
+{
+	ctx << 0x0Fuss << (uint8_t)(0x80uss | condition) << (int32_t)(address - (ctx.getCurrentAddress() + 4));
+}
+
 void CodeGenerator::emitNop()
 {
 	ctx << 0x90uss;
@@ -2,6 +2,7 @@
 #include <cstdint>
 
 #include "linker.hpp"
+#include "interner.hpp"
 
 namespace x64
 {
@@ -24,8 +25,107 @@ namespace x64
 		R14 = 14,
 		R15 = 15,
 	};
+
+	// condition codes in the order of their encoding in jcc and setcc, flipping the lowest bit negates one
+	enum Condition : uint8_t
+	{
+		O = 0,
+		NO = 1,
+		B = 2,
+		AE = 3,
+		E = 4,
+		NE = 5,
+		BE = 6,
+		A = 7,
+		S = 8,
+		NS = 9,
+		P = 10,
+		NP = 11,
+		L = 12,
+		GE = 13,
+		LE = 14,
+		G = 15,
+	};
+
+	inline Condition negate(Condition condition) { return (Condition)(condition ^ 1); }
 }
 
+// the instructions the InstructionSelector uses, named like the emitter that encodes them
+enum class MachineOp : uint8_t
+{
+	Label,
+
+	Push,
+	Pop,
+
+	AddRIm32,
+	AddRR,
+	SubRIm32,
+	SubRR,
+	IMulRR,
+	DivR,
+	IDivR,
+	Cqo,
+
+	NegR,
+	NotR,
+	AndRR,
+	OrRR,
+	XorRR,
+
+	ShlRCl,
+	ShrRCl,
+	SarRCl,
+	ShlRIm8,
+	ShrRIm8,
+	SarRIm8,
+
+	CmpRR,
+	TestRR,
+	SetCC,
+
+	MovRR,
+	MovRIm64,
+	MovRIm32,
+	MovR32Im32,
+	MovRel8R,
+	MovRel32R,
+	MovRRel32,
+
+	// loads that sign or zero extend a narrower value to 64 bit and stores of the low bits of a register
+	Movzx8RRel32,
+	Movsx8RRel32,
+	Movzx16RRel32,
+	Movsx16RRel32,
+	MovR32Rel32,
+	Movsx32RRel32,
+	MovRel32R8,
+	MovRel32R16,
+	MovRel32R32,
+
+	CallRipRel32,
+	Jmp,
+	JmpCC,
+	Return,
+};
+
+// one instruction before it is encoded. jumps and calls refer to their target by symbol, so instructions
+// can be removed or replaced before the addresses are known
+struct MachineInstruction
+{
+	MachineOp op;
+
+	// in the operand order of the emitter, memory operands are [reg + immediate]
+	uint8_t reg1 = 0, reg2 = 0;
+	int64_t immediate = 0;
+
+	// of SetCC and JmpCC
+	x64::Condition condition = x64::E;
+
+	// defined by a Label, target of a jump or call
+	Symbol label = {};
+};
+
 class CodeGenerator
 {
 private:
@@ -38,6 +138,9 @@ public:
 	void generateProlog(size_t numParameters, size_t stackSpace);
 	void generateEpilog(size_t numParameters, size_t stackSpace);
 
+	// encodes instruction, a Label defines its symbol at the current address
+	void emit(MachineInstruction const& instruction);
+
 public:
 	uint8_t modRm(uint8_t mod, uint8_t reg, uint8_t rm);
 	uint8_t sib(uint8_t scale, uint8_t idx, uint8_t base);
@@ -45,6 +148,8 @@ public:
 
 	void emitPush(uint8_t reg);
 	void emitPop(uint8_t reg);
+	void emitPushIm8(int8_t value);
+	void emitPushIm32(int32_t value);
 
 	void emitAddRIm8(uint8_t reg, uint8_t value);
 	void emitAddRIm32(uint8_t reg, uint32_t value);
@@ -57,7 +162,9 @@ public:
 	void emitMulR(uint8_t reg);
 	void emitDivR(uint8_t reg);
 	void emitIMulR(uint8_t reg);
+	void emitIMulRR(uint8_t reg1, uint8_t reg2);
 	void emitIDivR(uint8_t reg);
+	void emitCqo();
 
 	void emitNegR(uint8_t reg);
 	void emitNotR(uint8_t reg);
@@ -67,11 +174,23 @@ public:
 
 	void emitMovRR(uint8_t reg1, uint8_t reg2);
 	void emitMovRIm64(uint8_t reg, uint64_t value);
+	void emitMovRIm32(uint8_t reg, int32_t value);
+	void emitMovR32Im32(uint8_t reg, uint32_t value);
 	void emitMovRel8R(uint8_t reg1, int8_t offset, uint8_t reg2);
 	void emitMovRel32R(uint8_t reg1, int32_t offset, uint8_t reg2);
 	void emitMovRRel8(uint8_t reg1, uint8_t reg2, int8_t offset);
 	void emitMovRRel32(uint8_t reg1, uint8_t reg2, int32_t offset);
 
+	void emitMovzx8RRel32(uint8_t reg1, uint8_t reg2, int32_t offset);
+	void emitMovsx8RRel32(uint8_t reg1, uint8_t reg2, int32_t offset);
+	void emitMovzx16RRel32(uint8_t reg1, uint8_t reg2, int32_t offset);
+	void emitMovsx16RRel32(uint8_t reg1, uint8_t reg2, int32_t offset);
+	void emitMovR32Rel32(uint8_t reg1, uint8_t reg2, int32_t offset);
+	void emitMovsx32RRel32(uint8_t reg1, uint8_t reg2, int32_t offset);
+	void emitMovRel32R8(uint8_t reg1, int32_t offset, uint8_t reg2);
+	void emitMovRel32R16(uint8_t reg1, int32_t offset, uint8_t reg2);
+	void emitMovRel32R32(uint8_t reg1, int32_t offset, uint8_t reg2);
+
 	void emitAndRR(uint8_t reg1, uint8_t reg2);
 
 	void emitOrRR(uint8_t reg1, uint8_t reg2);
@@ -82,6 +201,10 @@ public:
 
 	void emitShlRCl(uint8_t reg);
 	void emitShrRCl(uint8_t reg);
+	void emitSarRCl(uint8_t reg);
+	void emitShlRIm8(uint8_t reg, uint8_t value);
+	void emitShrRIm8(uint8_t reg, uint8_t value);
+	void emitSarRIm8(uint8_t reg, uint8_t value);
 
 	void emitSetE(uint8_t reg);
 	void emitSetNe(uint8_t reg);
@@ -89,6 +212,11 @@ public:
 	void emitSetG(uint8_t reg);
 	void emitSetLe(uint8_t reg);
 	void emitSetGe(uint8_t reg);
+	void emitSetB(uint8_t reg);
+	void emitSetA(uint8_t reg);
+	void emitSetBe(uint8_t reg);
+	void emitSetAe(uint8_t reg);
+	void emitSetCC(x64::Condition condition, uint8_t reg);
 
 	void emitLeaRRipRel32(uint8_t reg, size_t address);
 
@@ -98,6 +226,7 @@ public:
 	void emitJmp(size_t address);
 	void emitJmpZ(size_t address);
 	void emitJmpNZ(size_t address);
+	void emitJmpCC(x64::Condition condition, size_t address);
 
 	void emitNop();
 
@@ -4,8 +4,15 @@
 #include "linker.hpp"
 #include "code_generator.hpp"
 #include "pe_generator.hpp"
-
-class CodeGenPass : AstVisitor
+#include "function_table.hpp"
+#include "ir_builder.hpp"
+#include "register_allocator.hpp"
+#include "instruction_selector.hpp"
+#include "peephole_optimizer.hpp"
+
+// lowers every function to ssa form, allocates registers for its values, selects the instructions and
+// rewrites them with the peephole optimizer. runs once for each pass of the linker
+class CodeGenPass
 {
 public:
 	Linker& ctx;
@@ -13,10 +20,10 @@ public:
 	TypeContext& typeCtx;
 	std::ostream& logStream;
 
-	std::unordered_map<std::string, std::pair<Type*, size_t>> localVariables;
-	std::unordered_map<std::string, std::vector<FunctionDeclaration>> functions;
-
-	size_t uid;
+	IrBuilder builder;
+	RegisterAllocator allocator;
+	PeepholeOptimizer peephole;
+	InstructionSelector selector;
 
 public:
 	CodeGenPass(Linker& ctx, CodeGenerator& codeGen, TypeContext& typeCtx, std::ostream& logStream) :
@@ -24,28 +31,10 @@ public:
 		codeGen(codeGen),
 		typeCtx(typeCtx),
 		logStream(logStream),
-		uid(0)
+		selector(ctx, codeGen, &peephole)
 	{
 	}
 
 public:
-	void generateCode(std::unordered_map<std::string, std::vector<FunctionDeclaration>> functions);
-	size_t align(size_t value, size_t alignment);
-
-public:
-	void visit(IntegerExpression* node) override;
-	void visit(IdentifierExpression* node) override;
-	void visit(UnaryExpression* node) override;
-	void visit(BinaryExpression* node) override;
-	void visit(CallExpression* node) override;
-	void visit(IndexExpression* node) override;
-
-	void visit(BlockStatement* node) override;
-	void visit(VariableStatement* node) override;
-	void visit(ReturnStatement* node) override;
-	void visit(WhileStatement* node) override;
-	void visit(IfStatement* node) override;
-
-	void visit(FunctionDeclaration* node) override;
-	void visit(Module* node) override;
-};
\ No newline at end of file
+	void generateCode(FunctionTable& functions);
+};
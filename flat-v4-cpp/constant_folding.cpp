@@ -0,0 +1,309 @@
+#include "constant_folding.hpp"
+
+AstNode* ConstantFoldingPass::visit(IntegerExpression* node)
+{
+	return node;
+}
+
+AstNode* ConstantFoldingPass::visit(IdentifierExpression* node)
+{
+	return node;
+}
+
+AstNode* ConstantFoldingPass::visit(UnaryExpression* node)
+{
+	node->expression = fold(node->expression);
+	if (!node->intrinsic)
+		return node;
+
+	if (node->type == Token::Plus)
+	{
+		simplified++;
+		return node->expression;
+	}
+
+	// the minimum of a signed type is written as the negation of a literal one past its maximum,
+	// which is only a valid value of the type once it is negated
+	uint64_t value;
+	if (node->type == Token::Minus && node->expression->kind == AstKind::IntegerExpression)
+		value = static_cast<IntegerExpression*>(node->expression)->value;
+	else if (!getLiteral(node->expression, value))
+		return node;
+
+	auto type = static_cast<BuiltinType*>(node->resolvedType);
+	switch (node->type)
+	{
+	case Token::Minus: return makeLiteral(node, truncate(0 - value, type));
+	case Token::BitwiseNot: return makeLiteral(node, truncate(~value, type));
+	case Token::LogicalNot: return makeLiteral(node, value ^ 1);
+	default: return node;
+	}
+}
+
+AstNode* ConstantFoldingPass::visit(BinaryExpression* node)
+{
+	node->left = fold(node->left);
+	node->right = fold(node->right);
+	if (!node->intrinsic)
+		return node;
+
+	uint64_t left, right, result;
+	if (getLiteral(node->left, left) && getLiteral(node->right, right))
+	{
+		auto type = static_cast<BuiltinType*>(node->left->resolvedType);
+		if (evaluate(node->type, type, left, right, result))
+			return makeLiteral(node, result);
+		return node;
+	}
+
+	return simplify(node);
+}
+
+AstNode* ConstantFoldingPass::visit(CallExpression* node)
+{
+	for (auto& arg : node->args)
+		arg = fold(arg);
+	return node;
+}
+
+AstNode* ConstantFoldingPass::visit(IndexExpression* node)
+{
+	node->expression = fold(node->expression);
+	for (auto& arg : node->args)
+		arg = fold(arg);
+	return node;
+}
+
+AstNode* ConstantFoldingPass::visit(BlockStatement* node)
+{
+	for (auto& statement : node->statements)
+		statement = static_cast<Statement*>(dispatch(statement));
+	return node;
+}
+
+AstNode* ConstantFoldingPass::visit(VariableStatement* node)
+{
+	for (auto& value : node->values)
+		value = fold(value);
+	return node;
+}
+
+AstNode* ConstantFoldingPass::visit(ReturnStatement* node)
+{
+	if (node->expression)
+		node->expression = fold(node->expression);
+	return node;
+}
+
+AstNode* ConstantFoldingPass::visit(WhileStatement* node)
+{
+	node->condition = fold(node->condition);
+	node->body = static_cast<Statement*>(dispatch(node->body));
+	return node;
+}
+
+AstNode* ConstantFoldingPass::visit(IfStatement* node)
+{
+	node->condition = fold(node->condition);
+	node->ifBody = static_cast<Statement*>(dispatch(node->ifBody));
+	if (node->elseBody)
+		node->elseBody = static_cast<Statement*>(dispatch(node->elseBody));
+	return node;
+}
+
+AstNode* ConstantFoldingPass::visit(FunctionDeclaration* node)
+{
+	node->body = static_cast<Statement*>(dispatch(node->body));
+	return node;
+}
+
+AstNode* ConstantFoldingPass::visit(Module* node)
+{
+	for (auto& declaration : node->declarations)
+		dispatch(declaration);
+	return node;
+}
+
+Expression* ConstantFoldingPass::fold(Expression* node)
+{
+	return static_cast<Expression*>(dispatch(node));
+}
+
+Expression* ConstantFoldingPass::simplify(BinaryExpression* node)
+{
+	uint64_t value;
+	bool leftLiteral = getLiteral(node->left, value);
+	if (!leftLiteral && !getLiteral(node->right, value))
+		return node;
+
+	// the operand that is kept, and the literal that is the other one
+	auto operand = leftLiteral ? node->right : node->left;
+	auto literal = leftLiteral ? node->left : node->right;
+
+	switch (node->type)
+	{
+	// x + 0, x | 0, x ^ 0 and x - 0, x << 0, x >> 0 where only the right operand is the neutral one
+	case Token::Plus:
+	case Token::BitwiseOr:
+	case Token::BitwiseXor:
+		if (value != 0)
+			return node;
+		break;
+	case Token::Minus:
+	case Token::ShiftLeft:
+	case Token::ShiftRight:
+		if (leftLiteral || value != 0)
+			return node;
+		break;
+
+	// x * 1, x / 1 and x * 0
+	case Token::Multiply:
+		if (value == 0 && isPure(operand))
+			operand = literal;
+		else if (value != 1)
+			return node;
+		break;
+	case Token::Divide:
+		if (leftLiteral || value != 1)
+			return node;
+		break;
+
+	// x & 0, and for booleans x && true, x && false, x || false, x || true
+	case Token::BitwiseAnd:
+	case Token::LogicalAnd:
+		if (value == 0 && isPure(operand))
+			operand = literal;
+		else if (value == 0 || node->type == Token::BitwiseAnd)
+			return node;
+		break;
+	case Token::LogicalOr:
+		if (value == 1 && isPure(operand))
+			operand = literal;
+		else if (value == 1)
+			return node;
+		break;
+
+	default:
+		return node;
+	}
+
+	simplified++;
+	return operand;
+}
+
+bool ConstantFoldingPass::getLiteral(Expression* node, uint64_t& value)
+{
+	if (node->kind != AstKind::IntegerExpression || !node->resolvedType || node->resolvedType->kind != TypeKind::Builtin)
+		return false;
+
+	value = static_cast<IntegerExpression*>(node)->value;
+	return truncate(value, static_cast<BuiltinType*>(node->resolvedType)) == value;
+}
+
+Expression* ConstantFoldingPass::makeLiteral(Expression* node, uint64_t value)
+{
+	auto literal = allocator.make<IntegerExpression>(node->begin, node->end, value, nullptr);
+	literal->resolvedType = node->resolvedType;
+	folded++;
+	return literal;
+}
+
+uint64_t ConstantFoldingPass::truncate(uint64_t value, BuiltinType* type)
+{
+	if (type->bitSize >= 64)
+		return value;
+
+	auto mask = (uint64_t(1) << type->bitSize) - 1;
+	value &= mask;
+	if (type->isSigned && (value >> (type->bitSize - 1)) != 0)
+		value |= ~mask;
+	return value;
+}
+
+bool ConstantFoldingPass::evaluate(Token op, BuiltinType* type, uint64_t left, uint64_t right, uint64_t& result)
+{
+	auto signedLeft = (int64_t)left, signedRight = (int64_t)right;
+	auto less = type->isSigned ? signedLeft < signedRight : left < right;
+	auto greater = type->isSigned ? signedLeft > signedRight : left > right;
+
+	switch (op)
+	{
+	case Token::Plus: result = left + right; break;
+	case Token::Minus: result = left - right; break;
+	case Token::Multiply: result = left * right; break;
+
+	case Token::Divide:
+	case Token::Modulo:
+		// the minimum divided by -1 does not fit the type
+		if (right == 0 || (type->isSigned && signedRight == -1 && left == truncate(uint64_t(1) << (type->bitSize - 1), type)))
+			return false;
+		if (type->isSigned)
+			result = (uint64_t)(op == Token::Divide ? signedLeft / signedRight : signedLeft % signedRight);
+		else
+			result = (op == Token::Divide) ? left / right : left % right;
+		break;
+
+	case Token::BitwiseAnd: result = left & right; break;
+	case Token::BitwiseOr: result = left | right; break;
+	case Token::BitwiseXor: result = left ^ right; break;
+
+	case Token::ShiftLeft:
+	case Token::ShiftRight:
+		if (right >= type->bitSize)
+			return false;
+		if (op == Token::ShiftLeft)
+			result = left << right;
+		else
+			result = type->isSigned ? (uint64_t)(signedLeft >> right) : left >> right;
+		break;
+
+	case Token::LogicalAnd: result = left & right; break;
+	case Token::LogicalOr: result = left | right; break;
+
+	// comparisons result in bool, which needs no truncation
+	case Token::Equal: result = left == right; return true;
+	case Token::NotEqual: result = left != right; return true;
+	case Token::LessThan: result = less; return true;
+	case Token::GreaterThan: result = greater; return true;
+	case Token::LessOrEqual: result = !greater; return true;
+	case Token::GreaterOrEqual: result = !less; return true;
+
+	default:
+		return false;
+	}
+
+	result = truncate(result, type);
+	return true;
+}
+
+bool ConstantFoldingPass::isPure(Expression* node)
+{
+	switch (node->kind)
+	{
+	case AstKind::IntegerExpression:
+	case AstKind::IdentifierExpression:
+		return true;
+	case AstKind::UnaryExpression:
+	{
+		auto unary = static_cast<UnaryExpression*>(node);
+		return !unary->target && isPure(unary->expression);
+	}
+	case AstKind::BinaryExpression:
+	{
+		auto binary = static_cast<BinaryExpression*>(node);
+		return binary->type != Token::Assign && !binary->target && isPure(binary->left) && isPure(binary->right);
+	}
+	case AstKind::IndexExpression:
+	{
+		auto index = static_cast<IndexExpression*>(node);
+		for (auto arg : index->args)
+		{
+			if (!isPure(arg))
+				return false;
+		}
+		return isPure(index->expression);
+	}
+	default:
+		return false;
+	}
+}
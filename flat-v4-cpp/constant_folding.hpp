@@ -0,0 +1,55 @@
+#pragma once
+#include "ast.hpp"
+
+// evaluates intrinsic operators on integer literals and drops operations that do not change their operand,
+// like x + 0 or x * 1. runs on the annotated ast between the semantic pass and code generation.
+// every visit returns the node that replaces the visited one, new literals are allocated from the pool of the module
+class ConstantFoldingPass : public StaticAstVisitor<ConstantFoldingPass, AstNode*>
+{
+private:
+	PoolAllocator& allocator;
+	size_t folded, simplified;
+
+public:
+	ConstantFoldingPass(PoolAllocator& allocator) :
+		allocator(allocator),
+		folded(0),
+		simplified(0)
+	{
+	}
+
+public:
+	AstNode* visit(IntegerExpression* node);
+	AstNode* visit(IdentifierExpression* node);
+	AstNode* visit(UnaryExpression* node);
+	AstNode* visit(BinaryExpression* node);
+	AstNode* visit(CallExpression* node);
+	AstNode* visit(IndexExpression* node);
+
+	AstNode* visit(BlockStatement* node);
+	AstNode* visit(VariableStatement* node);
+	AstNode* visit(ReturnStatement* node);
+	AstNode* visit(WhileStatement* node);
+	AstNode* visit(IfStatement* node);
+
+	AstNode* visit(FunctionDeclaration* node);
+	AstNode* visit(Module* node);
+
+	inline size_t getFolded() const { return folded; }
+	inline size_t getSimplified() const { return simplified; }
+
+private:
+	Expression* fold(Expression* node);
+	Expression* simplify(BinaryExpression* node);
+
+	// values are kept sign extended for signed types and zero extended for unsigned ones
+	bool getLiteral(Expression* node, uint64_t& value);
+	Expression* makeLiteral(Expression* node, uint64_t value);
+	uint64_t truncate(uint64_t value, BuiltinType* type);
+
+	// false for divisions by zero, overflowing divisions and shifts by the width or more, those are left to run time
+	bool evaluate(Token op, BuiltinType* type, uint64_t left, uint64_t right, uint64_t& result);
+
+	// whether an operand can be dropped without losing a call or an assignment
+	bool isPure(Expression* node);
+};
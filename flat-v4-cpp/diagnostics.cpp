@@ -0,0 +1,44 @@
+#include "diagnostics.hpp"
+#include <algorithm>
+
+void DiagnosticEngine::error(size_t position, std::string const& message)
+{
+	std::lock_guard lock(mutex);
+	diagnostics.push_back({ position, std::string_view(), message });
+	errorCount++;
+}
+
+void DiagnosticEngine::error(size_t begin, size_t end, std::string const& message)
+{
+	std::lock_guard lock(mutex);
+	diagnostics.push_back({ begin, source.text.substr(std::min(begin, source.text.length()), end - begin), message });
+	errorCount++;
+}
+
+void DiagnosticEngine::append(DiagnosticEngine& other)
+{
+	std::scoped_lock lock(mutex, other.mutex);
+	diagnostics.insert(diagnostics.end(), std::make_move_iterator(other.diagnostics.begin()), std::make_move_iterator(other.diagnostics.end()));
+	errorCount += other.errorCount;
+
+	other.diagnostics.clear();
+	other.errorCount = 0;
+}
+
+void DiagnosticEngine::flush()
+{
+	std::stable_sort(diagnostics.begin(), diagnostics.end(), [](auto const& a, auto const& b) {
+		return a.position < b.position;
+	});
+
+	for (auto& diagnostic : diagnostics)
+	{
+		auto location = source.getLocation(diagnostic.position);
+		logStream << "ln " << location.line << ", col " << location.column;
+		if (!diagnostic.snippet.empty())
+			logStream << ", \"" << diagnostic.snippet << "\"";
+		logStream << ": " << diagnostic.message << "\n";
+	}
+
+	diagnostics.clear();
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iostream>
+#include <mutex>
+
+#include "source_file.hpp"
+
+// thrown after an error has been reported to the DiagnosticEngine,
+// passes catch it to resume at the next statement or declaration
+class CompilationError : public std::exception
+{
+public:
+	CompilationError(std::string const& message) :
+		std::exception(message.c_str())
+	{
+	}
+};
+
+struct Diagnostic
+{
+	size_t position;
+	std::string_view snippet;
+	std::string message;
+};
+
+class DiagnosticEngine
+{
+public:
+	SourceFile const& source;
+	std::ostream& logStream;
+	std::vector<Diagnostic> diagnostics;
+	size_t errorCount;
+
+	// errors are reported from the parser threads
+	std::mutex mutex;
+
+public:
+	DiagnosticEngine(SourceFile const& source, std::ostream& logStream) :
+		source(source),
+		logStream(logStream),
+		errorCount(0)
+	{
+	}
+
+public:
+	void error(size_t position, std::string const& message);
+	void error(size_t begin, size_t end, std::string const& message);
+
+	bool hasErrors() const { return errorCount != 0; }
+	size_t getErrorCount() const { return errorCount; }
+
+	// moves the diagnostics of other behind the ones collected so far
+	void append(DiagnosticEngine& other);
+
+	// prints the collected diagnostics in source order
+	void flush();
+};
@@ -0,0 +1,52 @@
+#include "executable_memory.hpp"
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+ExecutableMemory::ExecutableMemory(void const* code, size_t size) :
+	data(nullptr),
+	size(size)
+{
+#ifdef _WIN32
+	data = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	if (!data)
+		throw std::exception("Could not allocate executable memory");
+
+	memcpy(data, code, size);
+	DWORD oldProtection;
+	if (!VirtualProtect(data, size, PAGE_EXECUTE_READ, &oldProtection))
+	{
+		VirtualFree(data, 0, MEM_RELEASE);
+		throw std::exception("Could not make memory executable");
+	}
+	FlushInstructionCache(GetCurrentProcess(), data, size);
+#else
+	data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (data == MAP_FAILED)
+		throw std::runtime_error("Could not allocate executable memory");
+
+	memcpy(data, code, size);
+	if (mprotect(data, size, PROT_READ | PROT_EXEC) != 0)
+	{
+		munmap(data, size);
+		throw std::runtime_error("Could not make memory executable");
+	}
+#endif
+}
+
+ExecutableMemory::~ExecutableMemory()
+{
+#ifdef _WIN32
+	if (data)
+		VirtualFree(data, 0, MEM_RELEASE);
+#else
+	if (data)
+		munmap(data, size);
+#endif
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+
+// pages the generated code is copied to, so it can be called without writing an image first.
+// the pages are made executable and read only once the code is in place
+class ExecutableMemory
+{
+private:
+	void* data;
+	size_t size;
+
+public:
+	ExecutableMemory(void const* code, size_t size);
+	~ExecutableMemory();
+
+	ExecutableMemory(ExecutableMemory const&) = delete;
+	ExecutableMemory& operator=(ExecutableMemory const&) = delete;
+
+public:
+	// Fn is a function pointer type, the code at offset has to follow the win64 convention
+	template<typename Fn>
+	Fn get(size_t offset) const { return reinterpret_cast<Fn>((char*)data + offset); }
+};
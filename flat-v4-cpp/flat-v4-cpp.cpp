@@ -3,6 +3,13 @@
 
 #include "parser.hpp"
 #include "semantic_pass.hpp"
+#include "constant_folding.hpp"
+#include "benchmark.hpp"
+#include "input_file.hpp"
+#include "thread_pool.hpp"
+#include "ast_file.hpp"
+#include "ir_builder.hpp"
+#include "codegen_pass.hpp"
 
 /*
 struct AstDump
@@ -156,36 +163,188 @@ private:
 
 int main(int argc, char* argv[])
 {
-	std::string inputFile, outputFile;
+	std::string inputFile, outputFile, emitAstFile, fromAstFile, emitIrFile;
+	size_t benchIterations = 0;
+	size_t threads = ThreadPool::getDefaultThreadCount();
+	bool printStats = false;
 
 	CLI::App app("flc");
-	app.add_option("input, -i, --input", inputFile)->required()->check(CLI::ExistingFile);
+	app.add_option("input, -i, --input", inputFile, "Source file, - reads from stdin")->required()->check(CLI::ExistingFile | CLI::IsMember({ "-" }));
 	app.add_option("output, -o, --output", outputFile)->required();
+	app.add_option("--bench", benchIterations, "Run the compiler phase benchmarks on the input the given number of times and exit");
+	app.add_option("--threads", threads, "Number of threads to parse and type check with, 1 runs everything on the main thread")->check(CLI::PositiveNumber);
+	app.add_option("--emit-ast", emitAstFile, "Write the parsed module to the given .ast file");
+	app.add_option("--from-ast", fromAstFile, "Load the module from the given .ast file instead of parsing the input, if it was written for the same input");
+	app.add_option("--emit-ir", emitIrFile, "Write the ssa form of every function to the given text file");
+	app.add_flag("--stats", printStats, "Print compiler statistics");
 
 	CLI11_PARSE(app, argc, argv);
 
-	std::ifstream in{ inputFile };
-	std::string input{ std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+	std::unique_ptr<InputFile> file;
+	try
+	{
+		file = std::make_unique<InputFile>(inputFile);
+	}
+	catch (std::exception& e)
+	{
+		std::cout << e.what() << "\n";
+		return 1;
+	}
+
+	auto input = file->text();
+
+	if (benchIterations)
+	{
+		Benchmark(input, benchIterations, std::cout).run();
+		return 0;
+	}
 
 	TypeContext ctx(64);
-	ctx.builtinTypes.try_emplace("u8", new BuiltinType(ctx, "u8", 8));
-	ctx.builtinTypes.try_emplace("u16", new BuiltinType(ctx, "u16", 16));
-	ctx.builtinTypes.try_emplace("u32", new BuiltinType(ctx, "u32", 32));
-	ctx.builtinTypes.try_emplace("u64", new BuiltinType(ctx, "u64", 64));
-	ctx.builtinTypes.try_emplace("i8", new BuiltinType(ctx, "i8", 8));
-	ctx.builtinTypes.try_emplace("i16", new BuiltinType(ctx, "i16", 16));
-	ctx.builtinTypes.try_emplace("i32", new BuiltinType(ctx, "i32", 32));
-	ctx.builtinTypes.try_emplace("i64", new BuiltinType(ctx, "i64", 64));
-	ctx.builtinTypes.try_emplace("bool", new BuiltinType(ctx, "bool", 1));
-	ctx.builtinTypes.try_emplace("char", new BuiltinType(ctx, "char", 8));
-	ctx.builtinTypes.try_emplace("pointer", new BuiltinType(ctx, "pointer", 64));
+	ctx.addBuiltinTypes();
 
 	std::string ast;
-	Parser parser(ctx, input, std::cout);
-	auto program = parser.module();
-	auto pass = SemanticValidationPass(ctx, input, std::cout);
-	pass.extractFunctions(program.get());
-	pass.validateFunctions();
+	SourceFile source(input);
+	DiagnosticEngine diagnostics(source, std::cout);
+
+	std::unique_ptr<ThreadPool> pool;
+	if (threads > 1)
+		pool = std::make_unique<ThreadPool>(threads);
+
+	std::unique_ptr<InputFile> astFile;
+	std::unique_ptr<Module> program;
+	if (!fromAstFile.empty())
+	{
+		try
+		{
+			astFile = std::make_unique<InputFile>(fromAstFile);
+			program = AstFile::load(astFile->text(), input, ctx);
+			if (!program)
+				std::cout << fromAstFile << " was written for a different input, parsing it instead\n";
+		}
+		catch (std::exception& e)
+		{
+			std::cout << e.what() << ", parsing the input instead\n";
+		}
+	}
+
+	if (!program)
+	{
+		// the stale file may be the one that is written below
+		astFile.reset();
+
+		Parser parser(ctx, source, diagnostics);
+		program = pool ? parser.module(*pool) : parser.module();
+
+		if (!emitAstFile.empty() && !diagnostics.hasErrors())
+		{
+			std::ofstream out(emitAstFile, std::ios::binary);
+			AstFile::write(FlatAst::build(program.get()), input, out);
+			if (!out)
+			{
+				std::cout << "Could not write " << emitAstFile << "\n";
+				return 1;
+			}
+		}
+	}
+
+	if (!diagnostics.hasErrors())
+	{
+		ctx.resolveTypes();
+
+		FunctionTable functions;
+		SemanticValidationPass pass(ctx, diagnostics, functions);
+		pass.extractFunctions(program.get());
+
+		if (pool)
+			pass.validateFunctions(*pool);
+		else
+			pass.validateFunctions();
+
+		// folding relies on the types the semantic pass annotated, so it only runs on valid programs
+		ConstantFoldingPass folding(*program->allocator);
+		if (!diagnostics.hasErrors())
+			folding.dispatch(program.get());
+
+		size_t irBlocks = 0, irInstructions = 0;
+		if (!emitIrFile.empty() && !diagnostics.hasErrors())
+		{
+			std::ofstream out(emitIrFile);
+			try
+			{
+				functions.assignLinkNames();
+				IrBuilder builder;
+				for (auto function : functions.getFunctions())
+				{
+					auto ir = builder.build(function);
+					ir.verify();
+					ir.print(out);
+					out << "\n";
+					irBlocks += ir.blocks.size();
+					irInstructions += ir.size();
+				}
+			}
+			catch (std::exception& e)
+			{
+				std::cout << e.what() << "\n";
+				return 1;
+			}
+
+			if (!out)
+			{
+				std::cout << "Could not write " << emitIrFile << "\n";
+				return 1;
+			}
+		}
+
+		// there is no output format for the code yet, it is only generated to report on it
+		Linker linker;
+		CodeGenerator codeGen(linker);
+		CodeGenPass codeGenPass(linker, codeGen, ctx, std::cout);
+		bool generated = false;
+		if (printStats && !diagnostics.hasErrors())
+		{
+			try
+			{
+				// the layout pass makes the same rewrites, only the ones of the final pass are counted
+				for (auto layoutPass : { true, false })
+				{
+					linker.beginPass(layoutPass);
+					codeGenPass.peephole.resetCounts();
+					codeGenPass.generateCode(functions);
+				}
+				generated = true;
+			}
+			catch (std::exception& e)
+			{
+				std::cout << "code generation: " << e.what() << "\n";
+				return 1;
+			}
+		}
+
+		if (printStats)
+		{
+			std::cout << "functions: " << pass.functions.size() << ", types: " << ctx.types.size() << "\n";
+			std::cout << "operators: " << pass.operatorCache.getIntrinsicLookups() << " intrinsic lookups, operator cache: "
+				<< pass.operatorCache.getHits() << " hits, " << pass.operatorCache.getMisses() << " misses, " << pass.operatorCache.size() << " entries\n";
+			std::cout << "constant folding: " << folding.getFolded() << " folded, " << folding.getSimplified() << " simplified\n";
+			if (!emitIrFile.empty())
+				std::cout << "ir: " << irBlocks << " blocks, " << irInstructions << " instructions\n";
+			if (generated)
+			{
+				std::cout << "code: " << linker.getData().size() << " bytes\npeephole:";
+				for (size_t i = 0; i < (size_t)PeepholeRule::Count; i++)
+					std::cout << (i ? ", " : " ") << codeGenPass.peephole.getCount((PeepholeRule)i) << " " << peepholeRuleNames[i];
+				std::cout << "\n";
+			}
+		}
+	}
+
+	if (diagnostics.hasErrors())
+	{
+		diagnostics.flush();
+		std::cout << diagnostics.getErrorCount() << " error(s)\n";
+		return 1;
+	}
 
 	/*for (auto& decl : program->declarations) {
 		//ast += AstDump(decl).text();
@@ -0,0 +1,168 @@
+#include "flat_ast.hpp"
+
+// appends the nodes of the pointer AST in post order
+struct FlatAstBuilder : public StaticAstVisitor<FlatAstBuilder>
+{
+	FlatAst& ast;
+	uint32_t result;
+
+	FlatAstBuilder(FlatAst& ast) :
+		ast(ast),
+		result(FlatAst::NONE)
+	{
+	}
+
+	uint32_t build(AstNode* node)
+	{
+		if (!node)
+			return FlatAst::NONE;
+		dispatch(node);
+		return result;
+	}
+
+	template<typename T>
+	uint32_t buildList(std::span<T*> nodes)
+	{
+		std::vector<uint32_t> elements;
+		elements.reserve(nodes.size());
+		for (auto node : nodes)
+			elements.push_back(build(node));
+		return ast.addList(elements);
+	}
+
+	void visit(IntegerExpression* node)
+	{
+		auto index = ast.addLiteral(node->value);
+		auto suffixType = node->suffixType ? ast.addType(node->suffixType) : FlatAst::NONE;
+		result = ast.addNode(AstKind::IntegerExpression, Token::Integer, node->begin, node->end, index, suffixType);
+	}
+
+	void visit(IdentifierExpression* node)
+	{
+		result = ast.addNode(AstKind::IdentifierExpression, Token::Identifier, node->begin, node->end, (uint32_t)node->value, 0);
+	}
+
+	void visit(UnaryExpression* node)
+	{
+		auto operand = build(node->expression);
+		result = ast.addNode(AstKind::UnaryExpression, node->type, node->begin, node->end, operand, 0);
+	}
+
+	void visit(BinaryExpression* node)
+	{
+		auto left = build(node->left);
+		auto right = build(node->right);
+		result = ast.addNode(AstKind::BinaryExpression, node->type, node->begin, node->end, left, right);
+	}
+
+	void visit(CallExpression* node)
+	{
+		auto callee = build(node->expression);
+		auto args = buildList(node->args);
+		result = ast.addNode(AstKind::CallExpression, Token::ParenOpen, node->begin, node->end, callee, args);
+	}
+
+	void visit(IndexExpression* node)
+	{
+		auto expression = build(node->expression);
+		auto args = buildList(node->args);
+		result = ast.addNode(AstKind::IndexExpression, Token::BracketOpen, node->begin, node->end, expression, args);
+	}
+
+	void visit(BlockStatement* node)
+	{
+		auto statements = buildList(node->statements);
+		result = ast.addNode(AstKind::BlockStatement, Token::BraceOpen, node->begin, node->end, statements, 0);
+	}
+
+	void visit(VariableStatement* node)
+	{
+		std::vector<uint32_t> names;
+		for (auto name : node->names)
+			names.push_back((uint32_t)name);
+		auto values = buildList(node->values);
+		result = ast.addNode(AstKind::VariableStatement, Token::Let, node->begin, node->end, ast.addList(names), values);
+	}
+
+	void visit(ReturnStatement* node)
+	{
+		auto expression = build(node->expression);
+		result = ast.addNode(AstKind::ReturnStatement, Token::Return, node->begin, node->end, expression, 0);
+	}
+
+	void visit(WhileStatement* node)
+	{
+		auto condition = build(node->condition);
+		auto body = build(node->body);
+		result = ast.addNode(AstKind::WhileStatement, Token::While, node->begin, node->end, condition, body);
+	}
+
+	void visit(IfStatement* node)
+	{
+		auto condition = build(node->condition);
+		uint32_t bodies[] = { build(node->ifBody), build(node->elseBody) };
+		result = ast.addNode(AstKind::IfStatement, Token::If, node->begin, node->end, condition, ast.addList(bodies));
+	}
+
+	void visit(FunctionDeclaration* node)
+	{
+		std::vector<uint32_t> elements;
+		elements.push_back(build(node->body));
+		elements.push_back(ast.addType(node->result));
+		for (auto& [name, type] : node->parameters)
+		{
+			elements.push_back((uint32_t)name);
+			elements.push_back(ast.addType(type));
+		}
+		result = ast.addNode(AstKind::FunctionDeclaration, Token::Function, node->begin, node->end, (uint32_t)node->name, ast.addList(elements));
+	}
+
+	void visit(Module* node)
+	{
+		auto declarations = buildList(node->declarations);
+		result = ast.addNode(AstKind::Module, Token::Eof, node->begin, node->end, declarations, 0);
+	}
+};
+
+FlatAst FlatAst::build(Module* module)
+{
+	FlatAst ast;
+	ast.root = FlatAstBuilder(ast).build(module);
+	return ast;
+}
+
+uint32_t FlatAst::addNode(AstKind kind, Token op, size_t begin, size_t end, uint32_t lhs, uint32_t rhs)
+{
+	tags.push_back({ kind, op });
+	spans.push_back({ (uint32_t)begin, (uint32_t)end });
+	data.push_back({ lhs, rhs });
+	return (uint32_t)(tags.size() - 1);
+}
+
+uint32_t FlatAst::addList(std::span<uint32_t const> elements)
+{
+	auto index = (uint32_t)extra.size();
+	extra.push_back((uint32_t)elements.size());
+	extra.insert(extra.end(), elements.begin(), elements.end());
+	return index;
+}
+
+uint32_t FlatAst::addLiteral(uint64_t value)
+{
+	literals.push_back(value);
+	return (uint32_t)(literals.size() - 1);
+}
+
+uint32_t FlatAst::addType(Type* type)
+{
+	auto [it, inserted] = typeIndices.try_emplace(type, (uint32_t)types.size());
+	if (inserted)
+		types.push_back(type);
+	return it->second;
+}
+
+size_t FlatAst::getMemoryUsage() const
+{
+	return tags.size() * sizeof(FlatTag) + spans.size() * sizeof(FlatSpan) + data.size() * sizeof(FlatData) +
+		extra.size() * sizeof(uint32_t) + literals.size() * sizeof(uint64_t) + types.size() * sizeof(Type*);
+}
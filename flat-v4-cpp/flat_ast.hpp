@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "ast.hpp"
+
+struct FlatTag
+{
+	AstKind kind;
+	Token op;
+};
+
+struct FlatSpan
+{
+	uint32_t begin, end;
+};
+
+// meaning of the two operands depends on the node kind:
+//   IntegerExpression     literal index, suffix type or NONE
+//   IdentifierExpression  symbol
+//   UnaryExpression       operand
+//   BinaryExpression      left, right
+//   CallExpression        callee, args list
+//   IndexExpression       expression, args list
+//   BlockStatement        statements list
+//   VariableStatement     names list (symbols), values list
+//   ReturnStatement       expression
+//   WhileStatement        condition, body
+//   IfStatement           condition, list of ifBody and elseBody
+//   FunctionDeclaration   name, list of body, result type and (name, type) pairs of the parameters
+//   Module                declarations list
+struct FlatData
+{
+	uint32_t lhs, rhs;
+};
+
+// struct-of-arrays AST, nodes are addressed by their index and stored after their children.
+// child lists are stored in extra as their length followed by the elements
+class FlatAst
+{
+public:
+	static constexpr uint32_t NONE = UINT32_MAX;
+
+	std::vector<FlatTag> tags;
+	std::vector<FlatSpan> spans;
+	std::vector<FlatData> data;
+
+	std::vector<uint32_t> extra;
+	std::vector<uint64_t> literals;
+	std::vector<Type*> types;
+
+	uint32_t root;
+
+private:
+	std::unordered_map<Type*, uint32_t> typeIndices;
+
+public:
+	FlatAst() :
+		root(NONE)
+	{
+	}
+
+public:
+	static FlatAst build(Module* module);
+
+	uint32_t addNode(AstKind kind, Token op, size_t begin, size_t end, uint32_t lhs, uint32_t rhs);
+	uint32_t addList(std::span<uint32_t const> elements);
+	uint32_t addLiteral(uint64_t value);
+	uint32_t addType(Type* type);
+
+	inline size_t size() const { return tags.size(); }
+	inline AstKind kind(uint32_t node) const { return tags[node].kind; }
+	inline std::span<uint32_t const> list(uint32_t index) const { return std::span<uint32_t const>(extra).subspan(index + 1, extra[index]); }
+	inline uint64_t literal(uint32_t node) const { return literals[data[node].lhs]; }
+
+	size_t getMemoryUsage() const;
+};
@@ -0,0 +1,48 @@
+#include "function_table.hpp"
+#include <algorithm>
+
+size_t FunctionTable::SignatureHash::operator()(SignatureView signature) const
+{
+	uint64_t hash = ((uint64_t)signature.name << 8) ^ signature.parameters.size();
+	for (auto parameter : signature.parameters)
+		hash = (hash ^ (uint64_t)parameter) * 0x9E3779B97F4A7C15;
+	return (size_t)(hash ^ (hash >> 32));
+}
+
+bool FunctionTable::SignatureEqual::operator()(SignatureView a, SignatureView b) const
+{
+	return a.name == b.name && std::equal(a.parameters.begin(), a.parameters.end(), b.parameters.begin(), b.parameters.end());
+}
+
+FunctionId FunctionTable::add(FunctionDeclaration* function, std::span<TypeId const> parameters)
+{
+	auto id = (FunctionId)functions.size();
+	auto [it, inserted] = signatures.try_emplace(Signature{ function->name, std::vector<TypeId>(parameters.begin(), parameters.end()) }, id);
+	if (!inserted)
+		return NONE;
+
+	functions.push_back(function);
+	return id;
+}
+
+FunctionId FunctionTable::find(Symbol name, std::span<TypeId const> parameters) const
+{
+	auto it = signatures.find(SignatureView{ name, parameters });
+	return (it != signatures.end()) ? it->second : NONE;
+}
+
+void FunctionTable::assignLinkNames()
+{
+	for (auto function : functions)
+	{
+		auto identifier = StringInterner::global().str(function->name) + "(";
+		for (size_t i = 0; i < function->parameters.size(); i++)
+		{
+			identifier += function->parameters[i].second->getResolvedType()->toString();
+			if (i + 1 != function->parameters.size())
+				identifier += ",";
+		}
+		identifier += ")";
+		function->linkName = StringInterner::global().intern(identifier);
+	}
+}
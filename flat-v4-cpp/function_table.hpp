@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "ast.hpp"
+
+// stable handle of a function in a FunctionTable
+enum class FunctionId : uint32_t {};
+
+// overloads keyed by name and the ids of their resolved parameter types,
+// so resolving a call is a single hash probe instead of a scan over all candidates
+class FunctionTable
+{
+public:
+	static constexpr FunctionId NONE = (FunctionId)UINT32_MAX;
+
+private:
+	struct SignatureView
+	{
+		Symbol name;
+		std::span<TypeId const> parameters;
+	};
+
+	struct Signature
+	{
+		Symbol name;
+		std::vector<TypeId> parameters;
+
+		operator SignatureView() const { return { name, parameters }; }
+	};
+
+	// transparent, so lookups do not have to copy the parameter ids into a Signature
+	struct SignatureHash
+	{
+		using is_transparent = void;
+		size_t operator()(SignatureView signature) const;
+	};
+
+	struct SignatureEqual
+	{
+		using is_transparent = void;
+		bool operator()(SignatureView a, SignatureView b) const;
+	};
+
+	std::vector<FunctionDeclaration*> functions;
+	std::unordered_map<Signature, FunctionId, SignatureHash, SignatureEqual> signatures;
+
+public:
+	// returns NONE if a function with the same name and parameter types was already added
+	FunctionId add(FunctionDeclaration* function, std::span<TypeId const> parameters);
+
+	// returns NONE if there is no overload with exactly these parameter types
+	FunctionId find(Symbol name, std::span<TypeId const> parameters) const;
+
+	inline FunctionDeclaration* get(FunctionId id) const { return functions[(size_t)id]; }
+
+	// in the order they were added
+	inline std::vector<FunctionDeclaration*> const& getFunctions() const { return functions; }
+	inline size_t size() const { return functions.size(); }
+
+	// sets FunctionDeclaration::linkName for the code generators, the name followed by the resolved parameter types
+	void assignLinkNames();
+};
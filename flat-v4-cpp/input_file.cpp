@@ -0,0 +1,170 @@
+#include "input_file.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static constexpr size_t READ_CHUNK_SIZE = 1 << 20;
+
+InputFile::InputFile(std::string const& path) :
+	data(nullptr),
+	size(0),
+	isMapped(false)
+#ifdef _WIN32
+	, fileHandle(INVALID_HANDLE_VALUE),
+	mappingHandle(nullptr)
+#endif
+{
+#ifdef _WIN32
+	if (path == "-")
+	{
+		if (!map(GetStdHandle(STD_INPUT_HANDLE)))
+			readStream();
+		return;
+	}
+
+	fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		throw std::exception(("Could not open " + path).c_str());
+
+	if (!map(fileHandle))
+	{
+		CloseHandle(fileHandle);
+		throw std::exception(("Could not map " + path).c_str());
+	}
+#else
+	if (path == "-")
+	{
+		if (!map(STDIN_FILENO))
+			readStream();
+		return;
+	}
+
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw std::runtime_error("Could not open " + path);
+
+	bool mapped = map(fd);
+	close(fd);
+	if (!mapped)
+		throw std::runtime_error("Could not map " + path);
+#endif
+}
+
+InputFile::~InputFile()
+{
+#ifdef _WIN32
+	if (isMapped && data)
+		UnmapViewOfFile(data);
+	if (mappingHandle)
+		CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(fileHandle);
+	if (!isMapped)
+		free((void*)data);
+#else
+	if (isMapped && data)
+		munmap((void*)data, size);
+	if (!isMapped)
+		free((void*)data);
+#endif
+}
+
+// maps a regular file, returns false for pipes and terminals
+#ifdef _WIN32
+bool InputFile::map(void* file)
+{
+	if (GetFileType(file) != FILE_TYPE_DISK)
+		return false;
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(file, &fileSize))
+		return false;
+
+	isMapped = true;
+	size = (size_t)fileSize.QuadPart;
+	if (size == 0)
+		return true;
+
+	mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mappingHandle)
+		return false;
+
+	data = (char const*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (!data)
+	{
+		// the destructor does not run if the constructor throws
+		CloseHandle(mappingHandle);
+		mappingHandle = nullptr;
+		return false;
+	}
+	return true;
+}
+#else
+bool InputFile::map(int file)
+{
+	struct stat info = {};
+	if (fstat(file, &info) != 0 || !S_ISREG(info.st_mode))
+		return false;
+
+	isMapped = true;
+	size = (size_t)info.st_size;
+	if (size == 0)
+		return true;
+
+	auto address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+	if (address == MAP_FAILED)
+		return false;
+
+	madvise(address, size, MADV_SEQUENTIAL);
+	data = (char const*)address;
+	return true;
+}
+#endif
+
+// reads stdin straight into one buffer that grows geometrically, large
+// reallocations are usually satisfied by remapping pages rather than copying
+void InputFile::readStream()
+{
+	isMapped = false;
+	size = 0;
+
+#ifdef _WIN32
+	_setmode(_fileno(stdin), _O_BINARY);
+#endif
+
+	char* buffer = nullptr;
+	size_t capacity = 0;
+	while (true)
+	{
+		if (capacity - size < READ_CHUNK_SIZE)
+		{
+			capacity = capacity ? capacity * 2 : READ_CHUNK_SIZE;
+			auto grown = (char*)realloc(buffer, capacity);
+			if (!grown)
+			{
+				free(buffer);
+				throw std::runtime_error("out of memory");
+			}
+			buffer = grown;
+		}
+
+		size_t count = fread(buffer + size, 1, capacity - size, stdin);
+		size += count;
+		if (count == 0)
+			break;
+	}
+
+	data = buffer;
+}
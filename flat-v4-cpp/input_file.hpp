@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+// read only view of a compiler input. files (and stdin redirected from a file) are
+// memory mapped, pipes are read in large chunks into a single growing buffer.
+class InputFile
+{
+private:
+	char const* data;
+	size_t size;
+	bool isMapped;
+
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#endif
+
+public:
+	// "-" reads from stdin
+	InputFile(std::string const& path);
+	~InputFile();
+
+	InputFile(InputFile const&) = delete;
+	InputFile& operator=(InputFile const&) = delete;
+
+public:
+	std::string_view text() const { return std::string_view(data, size); }
+
+private:
+#ifdef _WIN32
+	bool map(void* file);
+#else
+	bool map(int file);
+#endif
+	void readStream();
+};
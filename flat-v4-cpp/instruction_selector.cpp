@@ -0,0 +1,433 @@
+#include "instruction_selector.hpp"
+#include <algorithm>
+#include <bit>
+
+void InstructionSelector::select(IrFunction const& function, RegisterAllocation const& allocation)
+{
+	this->function = &function;
+	this->allocation = &allocation;
+
+	// win64 reserves at least 32 bytes for the callee to home its register arguments
+	size_t outgoing = 4;
+	for (auto& block : function.blocks)
+	{
+		for (auto& instruction : block.instructions)
+		{
+			if (instruction.op == IrOp::Call)
+				outgoing = std::max<size_t>(outgoing, instruction.operandCount);
+		}
+	}
+
+	// the call pushed the return address, so RSP is 16 byte aligned again if the saved registers and the frame are 8 mod 16
+	auto saved = (int32_t)allocation.savedRegisters.size() * 8;
+	spillOffset = (int32_t)(outgoing * 8);
+	frameSize = spillOffset + (int32_t)allocation.spillSlots * 8;
+	if ((frameSize + saved) % 16 != 8)
+		frameSize += 8;
+	parameterOffset = frameSize + saved + 8;
+
+	code.clear();
+	emit({ MachineOp::Label, 0, 0, 0, x64::E, function.declaration->linkName });
+
+	// home the register arguments, so every parameter is on the stack above the return address
+	uint8_t argumentRegs[] = { x64::RCX, x64::RDX, x64::R8, x64::R9 };
+	for (size_t i = 0; i < std::min<size_t>(function.declaration->parameters.size(), 4); i++)
+		emit({ MachineOp::MovRel8R, x64::RSP, argumentRegs[i], (int64_t)(8 + i * 8) });
+	for (auto reg : allocation.savedRegisters)
+		emit({ MachineOp::Push, reg });
+	emit({ MachineOp::SubRIm32, x64::RSP, 0, frameSize });
+
+	for (size_t i = 0; i < function.blocks.size(); i++)
+	{
+		auto next = (IrBlockId)(i + 1);
+		emit({ MachineOp::Label, 0, 0, 0, x64::E, getLabel((IrBlockId)i) });
+		for (auto& instruction : function.blocks[i].instructions)
+			selectInstruction(instruction, (IrBlockId)i, next);
+	}
+
+	if (peephole)
+		peephole->optimize(code);
+	for (auto& instruction : code)
+		codeGen.emit(instruction);
+
+	this->function = nullptr;
+	this->allocation = nullptr;
+}
+
+void InstructionSelector::selectInstruction(IrInstruction const& instruction, IrBlockId block, IrBlockId next)
+{
+	auto values = function->getOperands(instruction);
+	auto type = (instruction.result != IrFunction::NONE) ? function->getType(instruction.result) : nullptr;
+
+	switch (instruction.op)
+	{
+	case IrOp::Const:
+	{
+		auto reg = def(instruction.result, x64::RAX);
+		emit({ MachineOp::MovRIm64, reg, 0, (int64_t)instruction.immediate });
+		define(instruction.result, reg);
+		break;
+	}
+
+	case IrOp::Param:
+	{
+		auto reg = def(instruction.result, x64::RAX);
+		emit({ MachineOp::MovRRel32, reg, x64::RSP, parameterOffset + (int64_t)instruction.immediate * 8 });
+		define(instruction.result, reg);
+		break;
+	}
+
+	case IrOp::Neg:
+	case IrOp::Not:
+	{
+		auto reg = def(instruction.result, x64::RAX);
+		load(reg, values[0]);
+		if (instruction.op == IrOp::Neg)
+			emit({ MachineOp::NegR, reg });
+		else
+			emit({ MachineOp::NotR, reg });
+		normalize(reg, type);
+		define(instruction.result, reg);
+		break;
+	}
+
+	case IrOp::Add:
+	case IrOp::Sub:
+	case IrOp::Mul:
+	case IrOp::And:
+	case IrOp::Or:
+	case IrOp::Xor:
+	{
+		// the result is live where the operands are read, so it never shares a register with the right one
+		auto right = use(values[1], x64::RCX);
+		auto reg = def(instruction.result, x64::RAX);
+		load(reg, values[0]);
+		switch (instruction.op)
+		{
+		case IrOp::Add: emit({ MachineOp::AddRR, reg, right }); break;
+		case IrOp::Sub: emit({ MachineOp::SubRR, reg, right }); break;
+		case IrOp::Mul: emit({ MachineOp::IMulRR, reg, right }); break;
+		case IrOp::And: emit({ MachineOp::AndRR, reg, right }); break;
+		case IrOp::Or: emit({ MachineOp::OrRR, reg, right }); break;
+		default: emit({ MachineOp::XorRR, reg, right }); break;
+		}
+		if (instruction.op == IrOp::Add || instruction.op == IrOp::Sub || instruction.op == IrOp::Mul)
+			normalize(reg, type);
+		define(instruction.result, reg);
+		break;
+	}
+
+	case IrOp::Shl:
+	case IrOp::Shr:
+	{
+		load(x64::RCX, values[1]);
+		auto reg = def(instruction.result, x64::RAX);
+		load(reg, values[0]);
+		if (instruction.op == IrOp::Shl)
+			emit({ MachineOp::ShlRCl, reg });
+		else if (isSigned(type))
+			emit({ MachineOp::SarRCl, reg });
+		else
+			emit({ MachineOp::ShrRCl, reg });
+		normalize(reg, type);
+		define(instruction.result, reg);
+		break;
+	}
+
+	case IrOp::Div:
+	case IrOp::Mod:
+	{
+		// the operands are already extended to 64 bit, only the minimum divided by -1 needs the normalization
+		load(x64::RAX, values[0]);
+		auto divisor = use(values[1], x64::RCX);
+		if (isSigned(type))
+		{
+			emit({ MachineOp::Cqo });
+			emit({ MachineOp::IDivR, divisor });
+		}
+		else
+		{
+			emit({ MachineOp::XorRR, x64::RDX, x64::RDX });
+			emit({ MachineOp::DivR, divisor });
+		}
+		auto reg = (instruction.op == IrOp::Div) ? x64::RAX : x64::RDX;
+		normalize(reg, type);
+		define(instruction.result, reg);
+		break;
+	}
+
+	case IrOp::Equal:
+	case IrOp::NotEqual:
+	case IrOp::Less:
+	case IrOp::Greater:
+	case IrOp::LessOrEqual:
+	case IrOp::GreaterOrEqual:
+		selectCompare(instruction);
+		break;
+
+	case IrOp::Index:
+	{
+		auto reg = def(instruction.result, x64::RAX);
+		emitElementAddress(values[0], values[1], type);
+		switch (getAccessSize(type))
+		{
+		case 1: emit({ isSigned(type) ? MachineOp::Movsx8RRel32 : MachineOp::Movzx8RRel32, reg, x64::RAX, 0 }); break;
+		case 2: emit({ isSigned(type) ? MachineOp::Movsx16RRel32 : MachineOp::Movzx16RRel32, reg, x64::RAX, 0 }); break;
+		case 4: emit({ isSigned(type) ? MachineOp::Movsx32RRel32 : MachineOp::MovR32Rel32, reg, x64::RAX, 0 }); break;
+		default: emit({ MachineOp::MovRRel32, reg, x64::RAX, 0 }); break;
+		}
+		define(instruction.result, reg);
+		break;
+	}
+
+	case IrOp::Store:
+	{
+		auto element = function->getType(values[2]);
+		emitElementAddress(values[0], values[1], element);
+		auto value = use(values[2], x64::RCX);
+		switch (getAccessSize(element))
+		{
+		case 1: emit({ MachineOp::MovRel32R8, x64::RAX, value, 0 }); break;
+		case 2: emit({ MachineOp::MovRel32R16, x64::RAX, value, 0 }); break;
+		case 4: emit({ MachineOp::MovRel32R32, x64::RAX, value, 0 }); break;
+		default: emit({ MachineOp::MovRel32R, x64::RAX, value, 0 }); break;
+		}
+		break;
+	}
+
+	case IrOp::Call:
+		selectCall(instruction);
+		break;
+
+	case IrOp::Jump:
+		selectJump(block, instruction.targets[0], next);
+		break;
+
+	case IrOp::Branch:
+	{
+		// the builder splits critical edges, so the targets of a branch have no phis to copy
+		if (!function->getBlock(instruction.targets[0]).phis.empty() || !function->getBlock(instruction.targets[1]).phis.empty())
+			throw std::exception("ir: branch to a block with phis");
+
+		auto condition = use(values[0], x64::RAX);
+		emit({ MachineOp::TestRR, condition, condition });
+		if (instruction.targets[0] == next)
+		{
+			emitJump(MachineOp::JmpCC, getLabel(instruction.targets[1]), x64::E);
+		}
+		else
+		{
+			emitJump(MachineOp::JmpCC, getLabel(instruction.targets[0]), x64::NE);
+			if (instruction.targets[1] != next)
+				emitJump(MachineOp::Jmp, getLabel(instruction.targets[1]));
+		}
+		break;
+	}
+
+	case IrOp::Return:
+		if (!values.empty())
+			load(x64::RAX, values[0]);
+		selectEpilog();
+		break;
+
+	default:
+		throw std::exception("ir: invalid instruction");
+	}
+}
+
+void InstructionSelector::selectCompare(IrInstruction const& instruction)
+{
+	auto values = function->getOperands(instruction);
+	auto operandSigned = isSigned(function->getType(values[0]));
+
+	// RDX is cleared before the compare, the xor would change the flags afterwards
+	auto left = use(values[0], x64::RAX);
+	auto right = use(values[1], x64::RCX);
+	emit({ MachineOp::XorRR, x64::RDX, x64::RDX });
+	emit({ MachineOp::CmpRR, left, right });
+
+	x64::Condition condition;
+	switch (instruction.op)
+	{
+	case IrOp::Equal: condition = x64::E; break;
+	case IrOp::NotEqual: condition = x64::NE; break;
+	case IrOp::Less: condition = operandSigned ? x64::L : x64::B; break;
+	case IrOp::Greater: condition = operandSigned ? x64::G : x64::A; break;
+	case IrOp::LessOrEqual: condition = operandSigned ? x64::LE : x64::BE; break;
+	case IrOp::GreaterOrEqual: condition = operandSigned ? x64::GE : x64::AE; break;
+	default: throw std::exception("invalid compare");
+	}
+	emit({ MachineOp::SetCC, x64::RDX, 0, 0, condition });
+
+	define(instruction.result, x64::RDX);
+}
+
+void InstructionSelector::selectCall(IrInstruction const& instruction)
+{
+	auto values = function->getOperands(instruction);
+
+	// the first four arguments are passed in registers, the others above the home space of the callee.
+	// the values in caller saved registers all end at the call, so the argument registers are free to overwrite
+	for (size_t i = 4; i < values.size(); i++)
+		emit({ MachineOp::MovRel32R, x64::RSP, use(values[i], x64::RAX), (int64_t)(i * 8) });
+
+	uint8_t argumentRegs[] = { x64::RCX, x64::RDX, x64::R8, x64::R9 };
+	for (size_t i = 0; i < std::min<size_t>(values.size(), 4); i++)
+		moves.push_back({ { argumentRegs[i], 0 }, getLocation(values[i]) });
+	emitMoves();
+
+	emitJump(MachineOp::CallRipRel32, instruction.callee->linkName);
+	if (instruction.result != IrFunction::NONE)
+		define(instruction.result, x64::RAX);
+}
+
+void InstructionSelector::selectJump(IrBlockId block, IrBlockId target, IrBlockId next)
+{
+	auto& targetBlock = function->getBlock(target);
+	auto& predecessors = targetBlock.predecessors;
+	auto index = std::find(predecessors.begin(), predecessors.end(), block) - predecessors.begin();
+
+	for (auto& phi : targetBlock.phis)
+		moves.push_back({ getLocation(phi.result), getLocation(function->getOperands(phi)[index]) });
+	emitMoves();
+
+	if (target != next)
+		emitJump(MachineOp::Jmp, getLabel(target));
+}
+
+void InstructionSelector::emitElementAddress(IrValue array, IrValue index, Type* element)
+{
+	// the element sizes are powers of two, so the index is scaled with a shift
+	load(x64::RAX, index);
+	auto shift = std::countr_zero(getAccessSize(element));
+	if (shift)
+		emit({ MachineOp::ShlRIm8, x64::RAX, 0, shift });
+	emit({ MachineOp::AddRR, x64::RAX, use(array, x64::RCX) });
+}
+
+void InstructionSelector::selectEpilog()
+{
+	emit({ MachineOp::AddRIm32, x64::RSP, 0, frameSize });
+	for (auto it = allocation->savedRegisters.rbegin(); it != allocation->savedRegisters.rend(); ++it)
+		emit({ MachineOp::Pop, *it });
+	emit({ MachineOp::Return });
+}
+
+void InstructionSelector::emitMoves()
+{
+	std::erase_if(moves, [](auto const& move) { return move.first == move.second; });
+
+	while (!moves.empty())
+	{
+		// a move can be made once no other move still reads its target
+		auto ready = std::find_if(moves.begin(), moves.end(), [&](auto const& move) {
+			return std::none_of(moves.begin(), moves.end(), [&](auto const& other) { return other.second == move.first; });
+		});
+
+		if (ready != moves.end())
+		{
+			emitMove(ready->first, ready->second);
+			moves.erase(ready);
+			continue;
+		}
+
+		// only cycles are left. the first target is saved to RAX and read from there, which lets its move go first
+		auto target = moves.front().first;
+		Location temp = { x64::RAX, 0 };
+		emitMove(temp, target);
+		for (auto& move : moves)
+		{
+			if (move.second == target)
+				move.second = temp;
+		}
+	}
+}
+
+void InstructionSelector::emitMove(Location target, Location source)
+{
+	if (target == source)
+		return;
+
+	if (target.isRegister() && source.isRegister())
+	{
+		emit({ MachineOp::MovRR, target.reg, source.reg });
+	}
+	else if (target.isRegister())
+	{
+		emit({ MachineOp::MovRRel32, target.reg, x64::RSP, getSlotOffset(source) });
+	}
+	else if (source.isRegister())
+	{
+		emit({ MachineOp::MovRel32R, x64::RSP, source.reg, getSlotOffset(target) });
+	}
+	else
+	{
+		// RAX may hold the value that breaks a cycle
+		emit({ MachineOp::MovRRel32, x64::RCX, x64::RSP, getSlotOffset(source) });
+		emit({ MachineOp::MovRel32R, x64::RSP, x64::RCX, getSlotOffset(target) });
+	}
+}
+
+uint8_t InstructionSelector::use(IrValue value, uint8_t scratch)
+{
+	auto location = getLocation(value);
+	if (location.isRegister())
+		return location.reg;
+	load(scratch, value);
+	return scratch;
+}
+
+uint8_t InstructionSelector::def(IrValue value, uint8_t scratch)
+{
+	auto location = getLocation(value);
+	return location.isRegister() ? location.reg : scratch;
+}
+
+void InstructionSelector::define(IrValue value, uint8_t reg)
+{
+	emitMove(getLocation(value), { reg, 0 });
+}
+
+void InstructionSelector::load(uint8_t reg, IrValue value)
+{
+	emitMove({ reg, 0 }, getLocation(value));
+}
+
+void InstructionSelector::normalize(uint8_t reg, Type* type)
+{
+	auto bitSize = type->getBitSize();
+	if (bitSize >= 64)
+		return;
+
+	auto shift = (int64_t)(64 - bitSize);
+	emit({ MachineOp::ShlRIm8, reg, 0, shift });
+	emit({ isSigned(type) ? MachineOp::SarRIm8 : MachineOp::ShrRIm8, reg, 0, shift });
+}
+
+void InstructionSelector::emit(MachineInstruction const& instruction)
+{
+	code.push_back(instruction);
+}
+
+void InstructionSelector::emitJump(MachineOp op, Symbol target, x64::Condition condition)
+{
+	code.push_back({ op, 0, 0, 0, condition, target });
+}
+
+Symbol InstructionSelector::getLabel(IrBlockId block)
+{
+	return StringInterner::global().intern(StringInterner::global().str(function->declaration->linkName) + "#" + std::to_string((uint32_t)block));
+}
+
+size_t InstructionSelector::getAccessSize(Type* type)
+{
+	auto size = type->ctx.getLayout(type).size;
+	if (size != 1 && size != 2 && size != 4 && size != 8)
+		throw std::exception("ir: array element does not fit a register");
+	return size;
+}
+
+bool InstructionSelector::isSigned(Type* type)
+{
+	return type->kind == TypeKind::Builtin && static_cast<BuiltinType*>(type)->isSigned;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <vector>
+
+#include "ir.hpp"
+#include "linker.hpp"
+#include "code_generator.hpp"
+#include "register_allocator.hpp"
+#include "peephole_optimizer.hpp"
+
+// emits x64 for an IrFunction through the CodeGenerator, with the values where the RegisterAllocator put them.
+// RAX, RCX and RDX are scratch registers for operands in spill slots and for instructions with fixed registers.
+// values narrower than 64 bit are kept sign or zero extended like their type. the instructions of a function are collected
+// first, so the PeepholeOptimizer can rewrite them before they are encoded
+class InstructionSelector
+{
+private:
+	Linker& ctx;
+	CodeGenerator& codeGen;
+	PeepholeOptimizer* peephole;
+
+	IrFunction const* function;
+	RegisterAllocation const* allocation;
+
+	// offsets from RSP after the prolog. the outgoing arguments are at the bottom, the spill slots above them
+	int32_t spillOffset, frameSize, parameterOffset;
+
+	// copies that have to happen at once, for phis and register arguments
+	std::vector<std::pair<Location, Location>> moves;
+
+	std::vector<MachineInstruction> code;
+
+public:
+	// without a peephole optimizer the instructions are encoded as they are selected
+	InstructionSelector(Linker& ctx, CodeGenerator& codeGen, PeepholeOptimizer* peephole = nullptr) :
+		ctx(ctx),
+		codeGen(codeGen),
+		peephole(peephole),
+		function(nullptr),
+		allocation(nullptr),
+		spillOffset(0),
+		frameSize(0),
+		parameterOffset(0)
+	{
+	}
+
+public:
+	// FunctionTable::assignLinkNames has to be called first, the function and its calls are linked by link name
+	void select(IrFunction const& function, RegisterAllocation const& allocation);
+
+private:
+	void selectInstruction(IrInstruction const& instruction, IrBlockId block, IrBlockId next);
+	void selectCompare(IrInstruction const& instruction);
+	void selectCall(IrInstruction const& instruction);
+
+	// copies the phi operands for the edge from block to target and jumps there unless it is the next block
+	void selectJump(IrBlockId block, IrBlockId target, IrBlockId next);
+
+	// computes the address of the element of array at index into RAX
+	void emitElementAddress(IrValue array, IrValue index, Type* element);
+	void selectEpilog();
+
+	// emits the pending moves so that no source is overwritten before it is read, cycles go through RAX
+	void emitMoves();
+	void emitMove(Location target, Location source);
+
+	void emit(MachineInstruction const& instruction);
+	void emitJump(MachineOp op, Symbol target, x64::Condition condition = x64::E);
+
+	inline Location getLocation(IrValue value) const { return allocation->locations[(size_t)value]; }
+	inline int64_t getSlotOffset(Location location) const { return spillOffset + (int64_t)location.slot * 8; }
+
+	// the register that holds value, loaded into scratch if it is spilled
+	uint8_t use(IrValue value, uint8_t scratch);
+
+	// the register the result is computed in, scratch if it is spilled. define stores it afterwards
+	uint8_t def(IrValue value, uint8_t scratch);
+	void define(IrValue value, uint8_t reg);
+
+	void load(uint8_t reg, IrValue value);
+
+	// sign or zero extends the low bits of reg that belong to the type
+	void normalize(uint8_t reg, Type* type);
+
+	Symbol getLabel(IrBlockId block);
+
+	// bytes a value of type takes in memory, throws for the ones that are not loaded into a single register
+	size_t getAccessSize(Type* type);
+	bool isSigned(Type* type);
+};
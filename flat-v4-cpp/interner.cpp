@@ -0,0 +1,59 @@
+#include "interner.hpp"
+#include <algorithm>
+#include <cstring>
+
+StringInterner::StringInterner() :
+	blockPosition(nullptr),
+	blockRemaining(0)
+{
+}
+
+StringInterner& StringInterner::global()
+{
+	static StringInterner interner;
+	return interner;
+}
+
+Symbol StringInterner::intern(std::string_view text)
+{
+	std::lock_guard lock(mutex);
+
+	auto it = symbols.find(text);
+	if (it != symbols.end())
+		return it->second;
+
+	auto stored = store(text);
+	auto symbol = (Symbol)names.size();
+	names.push_back(stored);
+	symbols.try_emplace(stored, symbol);
+	return symbol;
+}
+
+std::string_view StringInterner::name(Symbol symbol)
+{
+	std::lock_guard lock(mutex);
+	return names.at((size_t)symbol);
+}
+
+size_t StringInterner::size()
+{
+	std::lock_guard lock(mutex);
+	return names.size();
+}
+
+std::string_view StringInterner::store(std::string_view text)
+{
+	if (text.length() > blockRemaining)
+	{
+		size_t size = std::max(BLOCK_SIZE, text.length());
+		blocks.push_back(std::make_unique<char[]>(size));
+		blockPosition = blocks.back().get();
+		blockRemaining = size;
+	}
+
+	memcpy(blockPosition, text.data(), text.length());
+	std::string_view stored(blockPosition, text.length());
+	blockPosition += text.length();
+	blockRemaining -= text.length();
+	return stored;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// 32-bit id of an interned string, equal ids mean equal strings
+enum class Symbol : uint32_t {};
+
+class StringInterner
+{
+private:
+	static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+	std::mutex mutex;
+	std::unordered_map<std::string_view, Symbol> symbols;
+	std::vector<std::string_view> names;
+
+	// interned text is copied into blocks that never move, so the string_views stay valid
+	std::vector<std::unique_ptr<char[]>> blocks;
+	char* blockPosition;
+	size_t blockRemaining;
+
+public:
+	StringInterner();
+
+	StringInterner(StringInterner const&) = delete;
+	StringInterner& operator=(StringInterner const&) = delete;
+
+public:
+	static StringInterner& global();
+
+	Symbol intern(std::string_view text);
+	std::string_view name(Symbol symbol);
+	std::string str(Symbol symbol) { return std::string(name(symbol)); }
+
+	// number of interned strings, symbols are numbered from 0 in the order they were interned
+	size_t size();
+
+private:
+	std::string_view store(std::string_view text);
+};
@@ -0,0 +1,374 @@
+#include "ir.hpp"
+#include <algorithm>
+#include <exception>
+
+IrBlockId IrFunction::addBlock()
+{
+	blocks.emplace_back();
+	return (IrBlockId)(blocks.size() - 1);
+}
+
+IrValue IrFunction::addValue(Type* type)
+{
+	valueTypes.push_back(type);
+	return (IrValue)(valueTypes.size() - 1);
+}
+
+std::span<IrBlockId const> IrFunction::getSuccessors(IrBlockId id) const
+{
+	auto& instructions = getBlock(id).instructions;
+	if (instructions.empty())
+		return {};
+
+	auto& terminator = instructions.back();
+	switch (terminator.op)
+	{
+	case IrOp::Jump: return std::span<IrBlockId const>(terminator.targets, 1);
+	case IrOp::Branch: return std::span<IrBlockId const>(terminator.targets, 2);
+	default: return {};
+	}
+}
+
+size_t IrFunction::size() const
+{
+	size_t count = 0;
+	for (auto& block : blocks)
+		count += block.phis.size() + block.instructions.size();
+	return count;
+}
+
+void IrFunction::verify() const
+{
+	if (blocks.empty())
+		throw std::exception("ir: function has no blocks");
+
+	// structure of the blocks and the edges between them
+	std::vector<std::vector<IrBlockId>> predecessors(blocks.size());
+	for (size_t i = 0; i < blocks.size(); i++)
+	{
+		auto& block = blocks[i];
+		if (block.instructions.empty() || !block.instructions.back().isTerminator())
+			throw std::exception("ir: block does not end with a terminator");
+
+		for (size_t j = 0; j + 1 < block.instructions.size(); j++)
+		{
+			if (block.instructions[j].isTerminator() || block.instructions[j].op == IrOp::Phi)
+				throw std::exception("ir: terminator or phi in the middle of a block");
+		}
+
+		for (auto& phi : block.phis)
+		{
+			if (phi.op != IrOp::Phi || phi.operandCount != block.predecessors.size())
+				throw std::exception("ir: phi does not have one operand per predecessor");
+		}
+
+		for (auto successor : getSuccessors((IrBlockId)i))
+		{
+			if ((size_t)successor >= blocks.size())
+				throw std::exception("ir: jump to a block that does not exist");
+			predecessors[(size_t)successor].push_back((IrBlockId)i);
+		}
+	}
+
+	for (size_t i = 0; i < blocks.size(); i++)
+	{
+		auto expected = blocks[i].predecessors;
+		std::sort(expected.begin(), expected.end());
+		std::sort(predecessors[i].begin(), predecessors[i].end());
+		if (expected != predecessors[i])
+			throw std::exception("ir: predecessors do not match the terminators");
+	}
+
+	// reverse post order and immediate dominators, as in "A Simple, Fast Dominance Algorithm" by Cooper, Harvey and Kennedy
+	std::vector<uint32_t> order, orderIndex(blocks.size(), UINT32_MAX);
+	{
+		std::vector<std::pair<uint32_t, size_t>> stack = { { 0, 0 } };
+		std::vector<bool> visited(blocks.size(), false);
+		visited[0] = true;
+		while (!stack.empty())
+		{
+			auto& [block, next] = stack.back();
+			auto successors = getSuccessors((IrBlockId)block);
+			if (next < successors.size())
+			{
+				auto successor = (uint32_t)successors[next++];
+				if (!visited[successor])
+				{
+					visited[successor] = true;
+					stack.push_back({ successor, 0 });
+				}
+				continue;
+			}
+			order.push_back(block);
+			stack.pop_back();
+		}
+		std::reverse(order.begin(), order.end());
+	}
+
+	if (order.size() != blocks.size())
+		throw std::exception("ir: unreachable block");
+	for (uint32_t i = 0; i < order.size(); i++)
+		orderIndex[order[i]] = i;
+
+	std::vector<uint32_t> idom(blocks.size(), UINT32_MAX);
+	idom[0] = 0;
+	for (bool changed = true; changed; )
+	{
+		changed = false;
+		for (size_t i = 1; i < order.size(); i++)
+		{
+			auto block = order[i];
+			auto newIdom = UINT32_MAX;
+			for (auto predecessor : blocks[block].predecessors)
+			{
+				auto other = (uint32_t)predecessor;
+				if (idom[other] == UINT32_MAX)
+					continue;
+				if (newIdom == UINT32_MAX)
+				{
+					newIdom = other;
+					continue;
+				}
+				while (other != newIdom)
+				{
+					while (orderIndex[other] > orderIndex[newIdom])
+						other = idom[other];
+					while (orderIndex[newIdom] > orderIndex[other])
+						newIdom = idom[newIdom];
+				}
+			}
+			if (idom[block] != newIdom)
+			{
+				idom[block] = newIdom;
+				changed = true;
+			}
+		}
+	}
+
+	auto dominates = [&](uint32_t a, uint32_t b) {
+		while (b != a && b != 0)
+			b = idom[b];
+		return b == a;
+	};
+
+	// definitions, phis are at position 0 and the other instructions follow them
+	struct Definition
+	{
+		uint32_t block, position;
+	};
+
+	std::vector<Definition> definitions(valueTypes.size(), { UINT32_MAX, 0 });
+	auto define = [&](IrInstruction const& instruction, uint32_t block, uint32_t position) {
+		if (instruction.result == NONE)
+			return;
+		if ((size_t)instruction.result >= valueTypes.size())
+			throw std::exception("ir: value out of range");
+		auto& definition = definitions[(size_t)instruction.result];
+		if (definition.block != UINT32_MAX)
+			throw std::exception("ir: value defined twice");
+		definition = { block, position };
+	};
+
+	for (uint32_t i = 0; i < blocks.size(); i++)
+	{
+		for (auto& phi : blocks[i].phis)
+			define(phi, i, 0);
+		for (uint32_t j = 0; j < blocks[i].instructions.size(); j++)
+			define(blocks[i].instructions[j], i, j + 1);
+	}
+
+	auto checkUse = [&](IrValue value, uint32_t block, uint32_t position) {
+		if ((size_t)value >= valueTypes.size() || definitions[(size_t)value].block == UINT32_MAX)
+			throw std::exception("ir: use of an undefined value");
+		auto& definition = definitions[(size_t)value];
+		if (definition.block == block ? definition.position >= position : !dominates(definition.block, block))
+			throw std::exception("ir: use of a value that is not dominated by its definition");
+	};
+
+	for (uint32_t i = 0; i < blocks.size(); i++)
+	{
+		auto& block = blocks[i];
+		for (auto& phi : block.phis)
+		{
+			auto values = getOperands(phi);
+			for (size_t j = 0; j < values.size(); j++)
+			{
+				// a phi operand is used at the end of its predecessor
+				checkUse(values[j], (uint32_t)block.predecessors[j], UINT32_MAX);
+				if (getType(values[j]) != getType(phi.result))
+					throw std::exception("ir: phi operand type mismatch");
+			}
+		}
+
+		for (uint32_t j = 0; j < block.instructions.size(); j++)
+		{
+			auto& instruction = block.instructions[j];
+			auto values = getOperands(instruction);
+			for (auto value : values)
+				checkUse(value, i, j + 1);
+
+			size_t expectedCount = 0;
+			bool hasResult = true;
+			switch (instruction.op)
+			{
+			case IrOp::Const:
+			case IrOp::Param:
+				break;
+
+			case IrOp::Neg:
+			case IrOp::Not:
+				expectedCount = 1;
+				break;
+
+			case IrOp::Store:
+				expectedCount = 3;
+				hasResult = false;
+				break;
+
+			case IrOp::Call:
+				if (!instruction.callee)
+					throw std::exception("ir: call without callee");
+				expectedCount = instruction.callee->parameters.size();
+				hasResult = instruction.result != NONE;
+				break;
+
+			case IrOp::Jump:
+				hasResult = false;
+				break;
+
+			case IrOp::Branch:
+				expectedCount = 1;
+				hasResult = false;
+				break;
+
+			case IrOp::Return:
+				// the value is left out for void functions and ones that fall off their end
+				expectedCount = std::min<size_t>(values.size(), 1);
+				hasResult = false;
+				break;
+
+			case IrOp::Phi:
+				throw std::exception("ir: phi in the middle of a block");
+
+			default:
+				expectedCount = 2;
+				break;
+			}
+
+			if (values.size() != expectedCount)
+				throw std::exception("ir: wrong number of operands");
+			if (hasResult != (instruction.result != NONE))
+				throw std::exception("ir: instruction result does not fit the operator");
+
+			// arithmetic keeps the type of its operands, comparisons only need operands of the same type
+			if (instruction.op >= IrOp::Neg && instruction.op <= IrOp::Shr)
+			{
+				for (auto value : values)
+				{
+					if (getType(value) != getType(instruction.result))
+						throw std::exception("ir: operand type mismatch");
+				}
+			}
+			else if (instruction.op >= IrOp::Equal && instruction.op <= IrOp::GreaterOrEqual)
+			{
+				if (getType(values[0]) != getType(values[1]))
+					throw std::exception("ir: operand type mismatch");
+			}
+			else if (instruction.op == IrOp::Index || instruction.op == IrOp::Store)
+			{
+				// an element is read or written as a value of the base type of the array
+				auto array = getType(values[0]);
+				auto element = (instruction.op == IrOp::Index) ? getType(instruction.result) : getType(values[2]);
+				if (array->kind != TypeKind::Array || !Type::areSame(static_cast<ArrayType*>(array)->base, element))
+					throw std::exception("ir: operand type mismatch");
+			}
+		}
+	}
+}
+
+void IrFunction::print(std::ostream& out) const
+{
+	auto value = [&](IrValue value) -> std::ostream& {
+		return out << "%" << (uint32_t)value;
+	};
+
+	out << "fn " << StringInterner::global().str(declaration->name) << "(";
+	for (size_t i = 0; i < declaration->parameters.size(); i++)
+		out << (i ? ", " : "") << declaration->parameters[i].second->toString();
+	out << "): " << declaration->result->toString() << "\n";
+
+	for (size_t i = 0; i < blocks.size(); i++)
+	{
+		auto& block = blocks[i];
+		out << "b" << i << ":";
+		for (size_t j = 0; j < block.predecessors.size(); j++)
+			out << (j ? ", b" : " ; preds b") << (uint32_t)block.predecessors[j];
+		out << "\n";
+
+		auto print = [&](IrInstruction const& instruction) {
+			out << "  ";
+			if (instruction.result != NONE)
+			{
+				auto type = getType(instruction.result);
+				value(instruction.result) << ": " << (type ? type->toString() : "?") << " = ";
+			}
+			out << irOpNames[(size_t)instruction.op];
+
+			auto values = getOperands(instruction);
+			switch (instruction.op)
+			{
+			case IrOp::Const:
+				if (instruction.result != NONE && getType(instruction.result)->kind == TypeKind::Builtin && static_cast<BuiltinType*>(getType(instruction.result))->isSigned)
+					out << " " << (int64_t)instruction.immediate;
+				else
+					out << " " << instruction.immediate;
+				break;
+
+			case IrOp::Param:
+				out << " " << instruction.immediate;
+				break;
+
+			case IrOp::Phi:
+				for (size_t j = 0; j < values.size(); j++)
+				{
+					out << (j ? ", [b" : " [b") << (uint32_t)block.predecessors[j] << " ";
+					value(values[j]) << "]";
+				}
+				break;
+
+			case IrOp::Call:
+				out << " " << StringInterner::global().str(instruction.callee->name) << "(";
+				for (size_t j = 0; j < values.size(); j++)
+				{
+					out << (j ? ", " : "");
+					value(values[j]);
+				}
+				out << ")";
+				break;
+
+			case IrOp::Jump:
+				out << " b" << (uint32_t)instruction.targets[0];
+				break;
+
+			case IrOp::Branch:
+				out << " ";
+				value(values[0]) << ", b" << (uint32_t)instruction.targets[0] << ", b" << (uint32_t)instruction.targets[1];
+				break;
+
+			default:
+				for (size_t j = 0; j < values.size(); j++)
+				{
+					out << (j ? ", " : " ");
+					value(values[j]);
+				}
+				break;
+			}
+			out << "\n";
+		};
+
+		for (auto& phi : block.phis)
+			print(phi);
+		for (auto& instruction : block.instructions)
+			print(instruction);
+	}
+}
@@ -0,0 +1,165 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <vector>
+
+#include "ast.hpp"
+
+// virtual register, defined by exactly one instruction
+enum class IrValue : uint32_t {};
+
+// index of a basic block in its IrFunction, the entry block is 0
+enum class IrBlockId : uint32_t {};
+
+enum class IrOp : uint8_t
+{
+	Const,
+	Param,
+	Phi,
+
+	Neg,
+	Not,
+
+	Add,
+	Sub,
+	Mul,
+	Div,
+	Mod,
+	And,
+	Or,
+	Xor,
+	Shl,
+	Shr,
+
+	Equal,
+	NotEqual,
+	Less,
+	Greater,
+	LessOrEqual,
+	GreaterOrEqual,
+
+	Index,
+	Store,
+	Call,
+
+	Jump,
+	Branch,
+	Return,
+};
+
+static constexpr const char* irOpNames[] =
+{
+	"const",
+	"param",
+	"phi",
+
+	"neg",
+	"not",
+
+	"add",
+	"sub",
+	"mul",
+	"div",
+	"mod",
+	"and",
+	"or",
+	"xor",
+	"shl",
+	"shr",
+
+	"eq",
+	"ne",
+	"lt",
+	"gt",
+	"le",
+	"ge",
+
+	"index",
+	"store",
+	"call",
+
+	"jump",
+	"branch",
+	"return",
+};
+
+struct IrInstruction
+{
+	IrOp op;
+
+	// IrFunction::NONE for instructions without a value
+	IrValue result;
+
+	// range in IrFunction::operands. the operands of a phi are in the order of the predecessors of its block,
+	// the ones of an Index are the array and the index, a Store has the stored value as a third one
+	uint32_t firstOperand, operandCount;
+
+	// value of a Const, index of a Param
+	uint64_t immediate;
+
+	// called function of a Call
+	FunctionDeclaration* callee;
+
+	// target of a Jump, true and false target of a Branch
+	IrBlockId targets[2];
+
+	inline bool isTerminator() const { return op == IrOp::Jump || op == IrOp::Branch || op == IrOp::Return; }
+};
+
+struct IrBlock
+{
+	// phis come before all other instructions of the block, so they are kept apart
+	std::vector<IrInstruction> phis;
+
+	// ends with the only terminator of the block
+	std::vector<IrInstruction> instructions;
+
+	std::vector<IrBlockId> predecessors;
+};
+
+// ssa form of one function. the builder splits every critical edge, so the phi copies
+// for an edge can always be placed at the end of its source block
+class IrFunction
+{
+public:
+	static constexpr IrValue NONE = (IrValue)UINT32_MAX;
+
+	FunctionDeclaration* declaration;
+	std::vector<IrBlock> blocks;
+
+	// resolved type of every value, indexed by IrValue
+	std::vector<Type*> valueTypes;
+
+	// operands of all instructions
+	std::vector<IrValue> operands;
+
+public:
+	IrFunction(FunctionDeclaration* declaration) :
+		declaration(declaration)
+	{
+	}
+
+public:
+	IrBlockId addBlock();
+	IrValue addValue(Type* type);
+
+	inline IrBlock& getBlock(IrBlockId id) { return blocks[(size_t)id]; }
+	inline IrBlock const& getBlock(IrBlockId id) const { return blocks[(size_t)id]; }
+	inline Type* getType(IrValue value) const { return valueTypes[(size_t)value]; }
+
+	inline std::span<IrValue> getOperands(IrInstruction const& instruction) { return std::span<IrValue>(operands).subspan(instruction.firstOperand, instruction.operandCount); }
+	inline std::span<IrValue const> getOperands(IrInstruction const& instruction) const { return std::span<IrValue const>(operands).subspan(instruction.firstOperand, instruction.operandCount); }
+
+	// targets of the terminator of a block, empty for blocks that return
+	std::span<IrBlockId const> getSuccessors(IrBlockId id) const;
+
+	// number of instructions including phis
+	size_t size() const;
+
+	// throws if the function is not in valid ssa form: every block ends in a terminator, the predecessor lists
+	// match the terminators, every value is defined once before it is used and the operand types fit the operators
+	void verify() const;
+
+	void print(std::ostream& out) const;
+};
@@ -0,0 +1,436 @@
+#include "ir_builder.hpp"
+
+IrFunction IrBuilder::build(FunctionDeclaration* declaration)
+{
+	IrFunction result(declaration);
+	function = &result;
+
+	localVariables.clear();
+	variableTypes.clear();
+	definitions.clear();
+	sealed.clear();
+	incompletePhis.clear();
+	replacements.clear();
+	removed.clear();
+
+	// the entry block has no predecessors, so it is sealed right away
+	current = addBlock();
+	sealBlock(current);
+
+	localVariables.pushScope();
+	for (size_t i = 0; i < declaration->parameters.size(); i++)
+	{
+		auto& [name, type] = declaration->parameters[i];
+		auto slot = (uint32_t)variableTypes.size();
+		variableTypes.push_back(type->getResolvedType());
+		localVariables.declare(name, variableTypes.back(), slot);
+		writeVariable(slot, current, emit(IrOp::Param, variableTypes.back(), {}, i));
+	}
+
+	dispatch(declaration->body);
+	if (current != NO_BLOCK)
+		emitReturn({});
+	localVariables.popScope();
+
+	finish();
+	function = nullptr;
+	return result;
+}
+
+IrValue IrBuilder::visit(IntegerExpression* node)
+{
+	return emit(IrOp::Const, getType(node), {}, node->value);
+}
+
+IrValue IrBuilder::visit(IdentifierExpression* node)
+{
+	auto variable = localVariables.find(node->value);
+	if (!variable)
+		throw std::exception("undefined identifier");
+	return readVariable((uint32_t)variable->slot, current);
+}
+
+IrValue IrBuilder::visit(UnaryExpression* node)
+{
+	auto operand = dispatch(node->expression);
+	if (node->target)
+		return emitCall(node->target, { &operand, 1 });
+
+	switch (node->type)
+	{
+	case Token::Plus: return operand;
+	case Token::Minus: return emit(IrOp::Neg, getType(node), { operand });
+	case Token::BitwiseNot: return emit(IrOp::Not, getType(node), { operand });
+	case Token::LogicalNot: return emit(IrOp::Xor, getType(node), { operand, emit(IrOp::Const, getType(node), {}, 1) });
+	default: throw std::exception("invalid unary operator type");
+	}
+}
+
+IrValue IrBuilder::visit(BinaryExpression* node)
+{
+	if (node->type == Token::Assign)
+	{
+		// the semantic pass only lets identifiers and index expressions be assigned to
+		if (node->left->kind == AstKind::IndexExpression)
+		{
+			auto target = static_cast<IndexExpression*>(node->left);
+			auto array = dispatch(target->expression);
+			auto index = dispatch(target->args[0]);
+			auto value = dispatch(node->right);
+			emit(IrOp::Store, nullptr, { array, index, value });
+			return value;
+		}
+
+		auto variable = localVariables.find(static_cast<IdentifierExpression*>(node->left)->value);
+		if (!variable)
+			throw std::exception("undefined identifier");
+
+		auto value = dispatch(node->right);
+		writeVariable((uint32_t)variable->slot, current, value);
+		return value;
+	}
+
+	IrValue operands[] = { dispatch(node->left), dispatch(node->right) };
+	if (node->target)
+		return emitCall(node->target, operands);
+	return emit(getOp(node->type), getType(node), { operands[0], operands[1] });
+}
+
+IrValue IrBuilder::visit(CallExpression* node)
+{
+	std::vector<IrValue> args;
+	for (auto arg : node->args)
+		args.push_back(dispatch(arg));
+	return emitCall(node->target, args);
+}
+
+IrValue IrBuilder::visit(IndexExpression* node)
+{
+	// the semantic pass rejects index expressions on arrays with more than one argument
+	auto value = dispatch(node->expression);
+	return emit(IrOp::Index, getType(node), { value, dispatch(node->args[0]) });
+}
+
+IrValue IrBuilder::visit(BlockStatement* node)
+{
+	localVariables.pushScope();
+	for (auto statement : node->statements)
+	{
+		// statements after a return are never executed
+		if (current == NO_BLOCK)
+			break;
+		dispatch(statement);
+	}
+	localVariables.popScope();
+	return IrFunction::NONE;
+}
+
+IrValue IrBuilder::visit(VariableStatement* node)
+{
+	for (size_t i = 0; i < node->names.size(); i++)
+	{
+		auto value = dispatch(node->values[i]);
+		auto slot = (uint32_t)variableTypes.size();
+		variableTypes.push_back(getType(node->values[i]));
+		localVariables.declare(node->names[i], variableTypes.back(), slot);
+		writeVariable(slot, current, value);
+	}
+	return IrFunction::NONE;
+}
+
+IrValue IrBuilder::visit(ReturnStatement* node)
+{
+	emitReturn({ dispatch(node->expression) });
+	return IrFunction::NONE;
+}
+
+IrValue IrBuilder::visit(WhileStatement* node)
+{
+	// the header is sealed after the body, when the jump back to it is known
+	auto header = addBlock();
+	emitJump(header);
+	current = header;
+
+	auto condition = dispatch(node->condition);
+	auto body = addBlock(), exit = addBlock();
+	emitBranch(condition, body, exit);
+	sealBlock(body);
+	sealBlock(exit);
+
+	current = body;
+	dispatch(node->body);
+	if (current != NO_BLOCK)
+		emitJump(header);
+	sealBlock(header);
+
+	current = exit;
+	return IrFunction::NONE;
+}
+
+IrValue IrBuilder::visit(IfStatement* node)
+{
+	// there is always an else block, so the edges into the join block are never critical
+	auto condition = dispatch(node->condition);
+	auto ifBlock = addBlock(), elseBlock = addBlock();
+	emitBranch(condition, ifBlock, elseBlock);
+	sealBlock(ifBlock);
+	sealBlock(elseBlock);
+
+	// the join block only exists if one of the branches does not return
+	auto join = NO_BLOCK;
+	current = ifBlock;
+	dispatch(node->ifBody);
+	if (current != NO_BLOCK)
+	{
+		join = addBlock();
+		emitJump(join);
+	}
+
+	current = elseBlock;
+	if (node->elseBody)
+		dispatch(node->elseBody);
+	if (current != NO_BLOCK)
+	{
+		if (join == NO_BLOCK)
+			join = addBlock();
+		emitJump(join);
+	}
+
+	if (join != NO_BLOCK)
+		sealBlock(join);
+	current = join;
+	return IrFunction::NONE;
+}
+
+IrValue IrBuilder::visit(FunctionDeclaration*)
+{
+	throw std::exception("functions are lowered with IrBuilder::build");
+}
+
+IrValue IrBuilder::visit(Module*)
+{
+	throw std::exception("functions are lowered with IrBuilder::build");
+}
+
+IrBlockId IrBuilder::addBlock()
+{
+	sealed.push_back(false);
+	incompletePhis.emplace_back();
+	return function->addBlock();
+}
+
+IrValue IrBuilder::addValue(Type* type)
+{
+	auto value = function->addValue(type);
+	replacements.push_back(value);
+	removed.push_back(false);
+	return value;
+}
+
+IrValue IrBuilder::emit(IrOp op, Type* type, std::initializer_list<IrValue> operands, uint64_t immediate)
+{
+	IrInstruction instruction = { op, type ? addValue(type) : IrFunction::NONE, (uint32_t)function->operands.size(), (uint32_t)operands.size(), immediate, nullptr, { NO_BLOCK, NO_BLOCK } };
+	function->operands.insert(function->operands.end(), operands);
+	function->getBlock(current).instructions.push_back(instruction);
+	return instruction.result;
+}
+
+IrValue IrBuilder::emitCall(FunctionDeclaration* callee, std::span<IrValue const> args)
+{
+	// void is not a type, so calls to functions without a result have no value
+	auto result = callee->result->tryGetResolvedType();
+	IrInstruction instruction = { IrOp::Call, result ? addValue(result) : IrFunction::NONE, (uint32_t)function->operands.size(), (uint32_t)args.size(), 0, callee, { NO_BLOCK, NO_BLOCK } };
+	function->operands.insert(function->operands.end(), args.begin(), args.end());
+	function->getBlock(current).instructions.push_back(instruction);
+	return instruction.result;
+}
+
+void IrBuilder::emitJump(IrBlockId target)
+{
+	emit(IrOp::Jump, nullptr, {});
+	function->getBlock(current).instructions.back().targets[0] = target;
+	function->getBlock(target).predecessors.push_back(current);
+	current = NO_BLOCK;
+}
+
+void IrBuilder::emitBranch(IrValue condition, IrBlockId ifTrue, IrBlockId ifFalse)
+{
+	emit(IrOp::Branch, nullptr, { condition });
+	auto& instruction = function->getBlock(current).instructions.back();
+	instruction.targets[0] = ifTrue;
+	instruction.targets[1] = ifFalse;
+	function->getBlock(ifTrue).predecessors.push_back(current);
+	function->getBlock(ifFalse).predecessors.push_back(current);
+	current = NO_BLOCK;
+}
+
+void IrBuilder::emitReturn(std::initializer_list<IrValue> operands)
+{
+	emit(IrOp::Return, nullptr, operands);
+	current = NO_BLOCK;
+}
+
+void IrBuilder::writeVariable(uint32_t variable, IrBlockId block, IrValue value)
+{
+	definitions[(uint64_t)variable << 32 | (uint32_t)block] = value;
+}
+
+IrValue IrBuilder::readVariable(uint32_t variable, IrBlockId block)
+{
+	auto it = definitions.find((uint64_t)variable << 32 | (uint32_t)block);
+	if (it != definitions.end())
+		return resolve(it->second);
+	return readVariableRecursive(variable, block);
+}
+
+IrValue IrBuilder::readVariableRecursive(uint32_t variable, IrBlockId block)
+{
+	IrValue value;
+	auto& predecessors = function->getBlock(block).predecessors;
+	if (!sealed[(size_t)block])
+	{
+		// the operands are added when the block is sealed
+		value = addValue(variableTypes[variable]);
+		function->getBlock(block).phis.push_back({ IrOp::Phi, value, 0, 0, 0, nullptr, { NO_BLOCK, NO_BLOCK } });
+		incompletePhis[(size_t)block].push_back({ variable, value });
+	}
+	else if (predecessors.size() == 1)
+	{
+		value = readVariable(variable, predecessors[0]);
+	}
+	else
+	{
+		// written before the operands are read, so a loop back to this block ends at the phi
+		value = addValue(variableTypes[variable]);
+		function->getBlock(block).phis.push_back({ IrOp::Phi, value, 0, 0, 0, nullptr, { NO_BLOCK, NO_BLOCK } });
+		writeVariable(variable, block, value);
+		value = addPhiOperands(variable, value, block);
+	}
+
+	writeVariable(variable, block, value);
+	return value;
+}
+
+IrValue IrBuilder::addPhiOperands(uint32_t variable, IrValue phi, IrBlockId block)
+{
+	// reading the operands may add instructions elsewhere, so the operands are appended in one piece afterwards
+	std::vector<IrValue> values;
+	for (auto predecessor : function->getBlock(block).predecessors)
+		values.push_back(readVariable(variable, predecessor));
+
+	auto instruction = findPhi(phi, block);
+	instruction->firstOperand = (uint32_t)function->operands.size();
+	instruction->operandCount = (uint32_t)values.size();
+	function->operands.insert(function->operands.end(), values.begin(), values.end());
+	return tryRemoveTrivialPhi(phi, block);
+}
+
+IrValue IrBuilder::tryRemoveTrivialPhi(IrValue phi, IrBlockId block)
+{
+	auto same = IrFunction::NONE;
+	for (auto operand : function->getOperands(*findPhi(phi, block)))
+	{
+		operand = resolve(operand);
+		if (operand == same || operand == phi)
+			continue;
+		if (same != IrFunction::NONE)
+			return phi;
+		same = operand;
+	}
+
+	if (same == IrFunction::NONE)
+		throw std::exception("variable is read before it is written");
+
+	replacements[(size_t)phi] = same;
+	removed[(size_t)phi] = true;
+	return same;
+}
+
+void IrBuilder::sealBlock(IrBlockId block)
+{
+	for (auto [variable, phi] : incompletePhis[(size_t)block])
+		addPhiOperands(variable, phi, block);
+	incompletePhis[(size_t)block].clear();
+	sealed[(size_t)block] = true;
+}
+
+IrValue IrBuilder::resolve(IrValue value)
+{
+	while (replacements[(size_t)value] != value)
+	{
+		// shortens the chain for the next lookup
+		auto next = replacements[(size_t)replacements[(size_t)value]];
+		replacements[(size_t)value] = next;
+		value = next;
+	}
+	return value;
+}
+
+IrInstruction* IrBuilder::findPhi(IrValue phi, IrBlockId block)
+{
+	for (auto& instruction : function->getBlock(block).phis)
+	{
+		if (instruction.result == phi)
+			return &instruction;
+	}
+	throw std::exception("ir: phi not found");
+}
+
+void IrBuilder::finish()
+{
+	// removing a phi can make the phis that use it trivial
+	for (bool changed = true; changed; )
+	{
+		changed = false;
+		for (size_t i = 0; i < function->blocks.size(); i++)
+		{
+			for (auto& phi : function->blocks[i].phis)
+			{
+				if (!removed[(size_t)phi.result] && tryRemoveTrivialPhi(phi.result, (IrBlockId)i) != phi.result)
+					changed = true;
+			}
+		}
+	}
+
+	for (auto& block : function->blocks)
+	{
+		std::erase_if(block.phis, [&](IrInstruction const& phi) { return removed[(size_t)phi.result]; });
+	}
+
+	for (auto& operand : function->operands)
+		operand = resolve(operand);
+}
+
+Type* IrBuilder::getType(Expression* node)
+{
+	return node->resolvedType->getResolvedType();
+}
+
+IrOp IrBuilder::getOp(Token op)
+{
+	switch (op)
+	{
+	case Token::Plus: return IrOp::Add;
+	case Token::Minus: return IrOp::Sub;
+	case Token::Multiply: return IrOp::Mul;
+	case Token::Divide: return IrOp::Div;
+	case Token::Modulo: return IrOp::Mod;
+	case Token::BitwiseAnd: return IrOp::And;
+	case Token::BitwiseOr: return IrOp::Or;
+	case Token::BitwiseXor: return IrOp::Xor;
+	case Token::ShiftLeft: return IrOp::Shl;
+	case Token::ShiftRight: return IrOp::Shr;
+
+	// both operands are always evaluated, there is no short circuit
+	case Token::LogicalAnd: return IrOp::And;
+	case Token::LogicalOr: return IrOp::Or;
+
+	case Token::Equal: return IrOp::Equal;
+	case Token::NotEqual: return IrOp::NotEqual;
+	case Token::LessThan: return IrOp::Less;
+	case Token::GreaterThan: return IrOp::Greater;
+	case Token::LessOrEqual: return IrOp::LessOrEqual;
+	case Token::GreaterOrEqual: return IrOp::GreaterOrEqual;
+	default: throw std::exception("invalid binary operator type");
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <unordered_map>
+#include <vector>
+
+#include "ast.hpp"
+#include "ir.hpp"
+#include "scope_stack.hpp"
+
+// lowers the annotated ast of one function to ssa form, as in "Simple and Efficient Construction of Static Single
+// Assignment Form" by Braun et al. variables are numbered by their slot in the scope stack, a block is sealed once
+// all of its predecessors are known and phis that only merge one value are replaced by that value
+class IrBuilder : public StaticAstVisitor<IrBuilder, IrValue>
+{
+private:
+	static constexpr IrBlockId NO_BLOCK = (IrBlockId)UINT32_MAX;
+
+	struct IncompletePhi
+	{
+		uint32_t variable;
+		IrValue phi;
+	};
+
+	IrFunction* function;
+
+	// block new instructions are appended to, NO_BLOCK after a return until the next block starts
+	IrBlockId current;
+
+	// the slot of a variable indexes variableTypes
+	ScopeStack localVariables;
+	std::vector<Type*> variableTypes;
+
+	// current value of a variable at the end of a block, keyed by variable << 32 | block
+	std::unordered_map<uint64_t, IrValue> definitions;
+
+	std::vector<bool> sealed;
+	std::vector<std::vector<IncompletePhi>> incompletePhis;
+
+	// the value a removed phi was replaced with, every other value maps to itself
+	std::vector<IrValue> replacements;
+	std::vector<bool> removed;
+
+public:
+	IrBuilder() :
+		function(nullptr),
+		current(NO_BLOCK)
+	{
+	}
+
+public:
+	// the declaration has to be validated and annotated by the semantic pass
+	IrFunction build(FunctionDeclaration* declaration);
+
+public:
+	IrValue visit(IntegerExpression* node);
+	IrValue visit(IdentifierExpression* node);
+	IrValue visit(UnaryExpression* node);
+	IrValue visit(BinaryExpression* node);
+	IrValue visit(CallExpression* node);
+	IrValue visit(IndexExpression* node);
+
+	IrValue visit(BlockStatement* node);
+	IrValue visit(VariableStatement* node);
+	IrValue visit(ReturnStatement* node);
+	IrValue visit(WhileStatement* node);
+	IrValue visit(IfStatement* node);
+
+	IrValue visit(FunctionDeclaration* node);
+	IrValue visit(Module* node);
+
+private:
+	IrBlockId addBlock();
+	IrValue addValue(Type* type);
+	IrValue emit(IrOp op, Type* type, std::initializer_list<IrValue> operands, uint64_t immediate = 0);
+	IrValue emitCall(FunctionDeclaration* callee, std::span<IrValue const> args);
+	void emitJump(IrBlockId target);
+	void emitBranch(IrValue condition, IrBlockId ifTrue, IrBlockId ifFalse);
+	void emitReturn(std::initializer_list<IrValue> operands);
+
+	void writeVariable(uint32_t variable, IrBlockId block, IrValue value);
+	IrValue readVariable(uint32_t variable, IrBlockId block);
+	IrValue readVariableRecursive(uint32_t variable, IrBlockId block);
+	IrValue addPhiOperands(uint32_t variable, IrValue phi, IrBlockId block);
+	IrValue tryRemoveTrivialPhi(IrValue phi, IrBlockId block);
+	void sealBlock(IrBlockId block);
+
+	IrValue resolve(IrValue value);
+	IrInstruction* findPhi(IrValue phi, IrBlockId block);
+
+	// removes the replaced phis and rewrites all operands to the values that replaced them
+	void finish();
+
+	Type* getType(Expression* node);
+	IrOp getOp(Token op);
+};
@@ -1,9 +1,33 @@
 #pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
 #include <string>
 #include <string_view>
+#include <unordered_map>
+#include <vector>
 #include <iostream>
 
 #include "token.hpp"
+#include "diagnostics.hpp"
+#include "scan.hpp"
+#include "interner.hpp"
+
+// value of an integer literal and the type name of its width suffix, which is empty if there is none
+struct IntegerLiteral
+{
+	uint64_t value;
+	std::string_view suffix;
+};
+
+// one entry of the pre-tokenized input, the text is input.substr(offset, length)
+struct TokenRecord
+{
+	Token kind;
+	uint32_t offset;
+	uint32_t length;
+};
 
 class Lexer
 {
@@ -53,29 +77,160 @@ private:
 		{ Token::Function, "fn" },
 	};
 
+	struct IntegerSuffix
+	{
+		std::string_view name;
+		uint8_t bitSize;
+		bool isSigned;
+	};
+
+	static constexpr IntegerSuffix integerSuffixes[] =
+	{
+		{ "u8", 8, false },
+		{ "u16", 16, false },
+		{ "u32", 32, false },
+		{ "u64", 64, false },
+		{ "i8", 8, true },
+		{ "i16", 16, true },
+		{ "i32", 32, true },
+		{ "i64", 64, true },
+	};
+
+	// character classes, used by the first-byte dispatch and the scanning loops
+	enum CharFlags : uint8_t
+	{
+		Whitespace = 0x01,
+		Digit = 0x02,
+		IdentifierStart = 0x04,
+		IdentifierPart = 0x08,
+	};
+
+	// first-byte dispatch entry: the token a byte forms on its own and the
+	// two-byte operators it can start, derived from the tokens table above
+	struct DispatchEntry
+	{
+		uint8_t flags = 0;
+		Token single = Token::Error;
+		char follow[2] = {};
+		Token pair[2] = { Token::Error, Token::Error };
+	};
+
+	static constexpr std::array<DispatchEntry, 256> buildDispatchTable()
+	{
+		std::array<DispatchEntry, 256> table = {};
+		for (size_t c = 0; c < 256; c++)
+		{
+			if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+				table[c].flags |= Whitespace;
+			if (c >= '0' && c <= '9')
+				table[c].flags |= Digit | IdentifierPart;
+			if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_')
+				table[c].flags |= IdentifierStart | IdentifierPart;
+		}
+
+		for (auto& [token, text] : tokens)
+		{
+			auto& entry = table[(uint8_t)text[0]];
+			if (text.length() == 1)
+			{
+				entry.single = token;
+				continue;
+			}
+
+			size_t slot = (entry.pair[0] == Token::Error) ? 0 : 1;
+			if (entry.pair[slot] != Token::Error)
+				throw "more than two operators share a first byte, widen DispatchEntry";
+			entry.follow[slot] = text[1];
+			entry.pair[slot] = token;
+		}
+
+		return table;
+	}
+
+	static const std::array<DispatchEntry, 256> dispatch;
+
+	// perfect hash over the keywords table, collisions are rejected at compile time
+	static constexpr size_t keywordTableSize = 8;
+
+	static constexpr size_t keywordHash(std::string_view text)
+	{
+		return ((uint8_t)text.front() * 2 + (uint8_t)text.back() * 3 + text.length()) & (keywordTableSize - 1);
+	}
+
+	static constexpr std::array<std::pair<Token, std::string_view>, keywordTableSize> buildKeywordTable()
+	{
+		std::array<std::pair<Token, std::string_view>, keywordTableSize> table = {};
+		for (auto& slot : table)
+			slot = { Token::Identifier, "" };
+		for (auto& keyword : keywords)
+		{
+			// a collision makes the constant evaluation of keywordTable fail
+			if (table[keywordHash(keyword.second)].first != Token::Identifier)
+				throw "keyword hash collision, adjust keywordHash or keywordTableSize";
+			table[keywordHash(keyword.second)] = keyword;
+		}
+		return table;
+	}
+
+	static const std::array<std::pair<Token, std::string_view>, keywordTableSize> keywordTable;
+
 protected:
 	size_t position;
 	std::string_view input;
 	std::string_view value;
-	std::ostream& logStream;
+	DiagnosticEngine& diagnostics;
+
+	// tokenView is either the tokenBuffer of this lexer or the token buffer of another lexer over the same input
+	std::vector<TokenRecord> tokenBuffer;
+	std::span<TokenRecord const> tokenView;
+	size_t cursor;
+
+	scan::Kernels kernels;
+
+	// identifiers repeat a lot, so most of them are resolved without going through the shared interner
+	std::unordered_map<std::string_view, Symbol> symbolCache;
 
 public:
-	Lexer(std::string_view input, std::ostream& logStream) :
+	Lexer(SourceFile const& source, DiagnosticEngine& diagnostics) :
 		position(0),
-		input(input),
+		input(source.text),
 		value(""),
-		logStream(logStream)
+		diagnostics(diagnostics),
+		cursor(0),
+		kernels(scan::getKernels())
+	{
+	}
+
+	// reads the already tokenized input, the token buffer has to outlive the lexer
+	Lexer(SourceFile const& source, DiagnosticEngine& diagnostics, std::span<TokenRecord const> tokenView) :
+		position(0),
+		input(source.text),
+		value(""),
+		diagnostics(diagnostics),
+		tokenView(tokenView),
+		cursor(0),
+		kernels(scan::getKernels())
 	{
 	}
 
 private:
 	void trim()
 	{
-		while (position < input.length() && isWhitespace(input[position]))
-			position++;
+		// most gaps are a single space, only longer runs go through the scan kernel
+		if (position < input.length() && isWhitespace(input[position]))
+			position = kernels.skipWhitespace(input.data(), position + 1, input.length());
 	}
 
 	Token advance()
+	{
+		auto token = scan();
+		if (token == Token::Error)
+			error("Invalid Token", true);
+		return token;
+	}
+
+	// scans one token at position without reporting errors, returns Token::Error on invalid input
+	Token scan()
 	{
 		if (position >= input.length())
 		{
@@ -83,112 +238,251 @@ private:
 			return Token::Eof;
 		}
 
-		size_t length = 0;
-		Token type = (Token)(-1);
-		for (auto& token : tokens)
+		auto& entry = dispatch[(uint8_t)input[position]];
+
+		if (entry.pair[0] != Token::Error && position + 1 < input.length())
 		{
-			if (length < token.second.length() && input.substr(position, token.second.length()) == token.second)
+			for (size_t i = 0; i < 2; i++)
 			{
-				length = token.second.length();
-				type = token.first;
+				if (entry.pair[i] != Token::Error && entry.follow[i] == input[position + 1])
+				{
+					value = input.substr(position, 2);
+					position += 2;
+					return entry.pair[i];
+				}
 			}
 		}
 
-		if (type != (Token)(-1))
+		if (entry.single != Token::Error)
 		{
-			value = input.substr(position, length);
-			position += length;
-			return type;
+			value = input.substr(position, 1);
+			position += 1;
+			return entry.single;
 		}
 
-		if (isDigit(input[position]))
+		if (entry.flags & Digit)
 		{
+			// letters belong to the literal as well, for the 0x and 0b prefixes and the width suffixes
 			size_t start = position;
-			while (position < input.length() && isDigit(input[position])) 
-				position++;
+			position = kernels.skipIdentifier(input.data(), position + 1, input.length());
 			value = input.substr(start, position - start);
 			return Token::Integer;
 		}
 
-		if (isIdentifier(input[position]))
+		if (entry.flags & IdentifierStart)
 		{
 			size_t start = position;
-			while (position < input.length() && isIdentifier(input[position])) 
-				position++;
+			position = kernels.skipIdentifier(input.data(), position + 1, input.length());
 			value = input.substr(start, position - start);
 
-			for (auto& keyword : keywords)
+			if (value.length() <= 6)
 			{
-				if (input.substr(start, position - start) == keyword.second)
-				{
+				auto& keyword = keywordTable[keywordHash(value)];
+				if (keyword.second == value)
 					return keyword.first;
-				}
 			}
 
 			return Token::Identifier;
 		}
 
-		error("Invalid Token", true);
 		return Token::Error;
 	}
 
 public:
-	bool match(Token expected)
+	Token next()
 	{
 		trim();
-		size_t start = position;
-		Token actual = advance();
-		if (actual == expected)
-			return true;
-		if (actual == Token::Eof)
+		return advance();
+	}
+
+	// lexes the whole input once into tokenBuffer, match and expect then only move a cursor.
+	// an invalid byte becomes a Token::Error entry which is reported once the parser
+	// reaches it, so errors are raised in the same order as with on demand lexing.
+	void tokenize()
+	{
+		if (input.length() > UINT32_MAX)
+			error("Input exceeds the maximum size of 4 GiB", true);
+
+		tokenBuffer.clear();
+		tokenBuffer.reserve(input.length() / 4 + 1);
+
+		position = 0;
+		while (true)
+		{
+			trim();
+			size_t start = position;
+			Token kind = scan();
+			if (kind == Token::Error)
+				position++;
+			tokenBuffer.push_back({ kind, (uint32_t)start, (uint32_t)(position - start) });
+			if (kind == Token::Eof)
+				break;
+		}
+		tokenView = tokenBuffer;
+
+		position = 0;
+		cursor = 0;
+		value = "";
+	}
+
+	Token peek()
+	{
+		if (tokenView.empty())
+			tokenize();
+		return tokenView[cursor].kind;
+	}
+
+	size_t mark()
+	{
+		return cursor;
+	}
+
+	void rewind(size_t mark)
+	{
+		cursor = mark;
+		position = (mark == 0) ? 0 : (tokenView[mark - 1].offset + tokenView[mark - 1].length);
+	}
+
+	bool match(Token expected)
+	{
+		auto& token = current();
+		if (token.kind == expected)
+			return consume(token);
+		position = token.offset;
+		if (token.kind == Token::Eof)
 			error("Unexpected EOF", true);
-		position = start;
 		return false;
 	}
 
+	// the kind of the token under the cursor without consuming it, moves position like a failed match
+	Token lookahead()
+	{
+		auto& token = current();
+		position = token.offset;
+		if (token.kind == Token::Eof)
+			error("Unexpected EOF", true);
+		return token.kind;
+	}
+
 	bool expect(Token expected)
 	{
-		trim();
-		size_t start = position;
-		Token actual = advance();
-		if (actual == expected)
-			return true;
-		position = start;
+		auto& token = current();
+		if (token.kind == expected)
+			return consume(token);
+		position = token.offset;
 		error("Unexpected Token " + std::string(value) + ", expected " + tokenNames[(size_t)expected], true);
 		return false;
 	}
 
+private:
+	// the token under the cursor, value is updated like it was by advance()
+	TokenRecord const& current()
+	{
+		if (tokenView.empty())
+			tokenize();
+
+		auto& token = tokenView[cursor];
+		value = input.substr(token.offset, token.length);
+		if (token.kind == Token::Error)
+		{
+			position = token.offset;
+			error("Invalid Token", true);
+		}
+		return token;
+	}
+
+	bool consume(TokenRecord const& token)
+	{
+		position = token.offset + token.length;
+		if (token.kind != Token::Eof)
+			cursor++;
+		return true;
+	}
+
 public:
-	std::string integer()
+	// parses the current integer token, decimal or with a 0x or 0b prefix, optionally followed by a width suffix
+	IntegerLiteral integer()
 	{
-		return std::string(value);
+		uint64_t base = 10;
+		size_t start = 0;
+		if (value.length() > 2 && value[0] == '0' && (value[1] == 'x' || value[1] == 'X'))
+			base = 16, start = 2;
+		else if (value.length() > 2 && value[0] == '0' && (value[1] == 'b' || value[1] == 'B'))
+			base = 2, start = 2;
+
+		uint64_t result = 0;
+		size_t end = start;
+		for (; end < value.length(); end++)
+		{
+			auto digit = digitValue(value[end]);
+			if (digit >= base)
+				break;
+			if (result > (UINT64_MAX - digit) / base)
+				error("Integer literal out of range", true);
+			result = result * base + digit;
+		}
+
+		if (end == start)
+			error("Invalid integer literal", true);
+
+		auto suffix = value.substr(end);
+		if (!suffix.empty())
+		{
+			auto it = std::find_if(std::begin(integerSuffixes), std::end(integerSuffixes), [&](auto& entry) { return entry.name == suffix; });
+			if (it == std::end(integerSuffixes))
+				error("Invalid integer literal suffix", true);
+
+			// literals are not negative, a signed type takes one more than its maximum for the negated minimum.
+			// the semantic pass checks that only a negated literal uses it
+			auto limit = it->isSigned ? (uint64_t)1 << (it->bitSize - 1) : (it->bitSize < 64 ? ((uint64_t)1 << it->bitSize) - 1 : UINT64_MAX);
+			if (result > limit)
+				error("Integer literal out of range for " + std::string(suffix), true);
+		}
+
+		return { result, suffix };
 	}
 
-	std::string identifier()
+	Symbol identifier()
 	{
-		return std::string(value);
+		auto it = symbolCache.find(value);
+		if (it != symbolCache.end())
+			return it->second;
+		return symbolCache.try_emplace(value, StringInterner::global().intern(value)).first->second;
 	}
 
 public:
 	void error(std::string message, bool fatal = false)
 	{
-		size_t line = 1, column = 1;
-		for (size_t i = 0; i < position && i < input.length(); i++) {
-			if (input[i] == '\n') {
-				line++;
-				column = 1;
-			} else {
-				column++;
-			}
+		diagnostics.error(position, message);
+		if (fatal) throw CompilationError(message);
+	}
+
+	// skips ahead to the next token of the given kind after an error,
+	// returns false if the end of the input is reached first
+	bool recover(Token kind)
+	{
+		if (tokenView.empty())
+			return false;
+
+		while (tokenView[cursor].kind != kind)
+		{
+			if (tokenView[cursor].kind == Token::Eof)
+				return false;
+			cursor++;
 		}
 
-		logStream << "ln " << line << ", col " << column << ": " << message << "\n";
-		if(fatal) throw std::exception(message.c_str());
+		rewind(cursor);
+		return true;
 	}
 
 private:
-	bool isDigit(char c) { return (c >= '0' && c <= '9'); }
+	bool isDigit(char c) { return dispatch[(uint8_t)c].flags & Digit; }
+	uint64_t digitValue(char c) { return (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : UINT64_MAX; }
 	bool isLetter(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
-	bool isWhitespace(char c) { return (c == ' ' || c == '\t' || c == '\r' || c == '\n'); }
-	bool isIdentifier(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || (c == '_'); }
-};
\ No newline at end of file
+	bool isWhitespace(char c) { return dispatch[(uint8_t)c].flags & Whitespace; }
+	bool isIdentifier(char c) { return dispatch[(uint8_t)c].flags & IdentifierPart; }
+};
+
+// the tables are defined after the class so their builders can see the complete Lexer
+inline constexpr std::array<Lexer::DispatchEntry, 256> Lexer::dispatch = Lexer::buildDispatchTable();
+inline constexpr std::array<std::pair<Token, std::string_view>, Lexer::keywordTableSize> Lexer::keywordTable = Lexer::buildKeywordTable();
@@ -16,21 +16,21 @@ Linker& Linker::beginPass(bool isLayoutPass)
 	return *this;
 }
 
-Linker& Linker::symbol(std::string const& name)
+Linker& Linker::symbol(Symbol name)
 {
 	if(isLayoutPass)
 		symbols.try_emplace(name, std::pair<size_t, size_t>(rawAddress, virtualAddress));
 	return *this;
 }
 
-size_t Linker::getSymbol(std::string const& name)
+size_t Linker::getSymbol(Symbol name)
 {
 	if (!isLayoutPass)
 		return symbols.at(name).second;
 	return 0;
 }
 
-size_t Linker::getSymbolRaw(std::string const& name)
+size_t Linker::getSymbolRaw(Symbol name)
 {
 	if (!isLayoutPass)
 		return symbols.at(name).first;
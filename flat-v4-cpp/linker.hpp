@@ -4,6 +4,7 @@
 #include <unordered_map>
 
 #include "blob.hpp"
+#include "interner.hpp"
 
 #undef min
 #undef max
@@ -13,7 +14,7 @@ class Linker
 private:
 	Blob buffer;
 	size_t rawAddress, virtualAddress;
-	std::unordered_map<std::string, std::pair<size_t, size_t>> symbols;
+	std::unordered_map<Symbol, std::pair<size_t, size_t>> symbols;
 	bool isLayoutPass;
 
 public:
@@ -22,9 +23,13 @@ public:
 public:
 	Linker& beginPass(bool layoutPass);
 
-	Linker& symbol(std::string const& name);
-	size_t getSymbol(std::string const& name);
-	size_t getSymbolRaw(std::string const& name);
+	Linker& symbol(Symbol name);
+	size_t getSymbol(Symbol name);
+	size_t getSymbolRaw(Symbol name);
+
+	inline Linker& symbol(std::string_view name) { return symbol(StringInterner::global().intern(name)); }
+	inline size_t getSymbol(std::string_view name) { return getSymbol(StringInterner::global().intern(name)); }
+	inline size_t getSymbolRaw(std::string_view name) { return getSymbolRaw(StringInterner::global().intern(name)); }
 
 	inline size_t getCurrentAddress() { return virtualAddress; }
 	inline size_t getCurrentAddressRaw() { return rawAddress; }
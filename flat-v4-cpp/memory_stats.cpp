@@ -0,0 +1,85 @@
+#include "memory_stats.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#ifdef FLC_COUNT_ALLOCATIONS
+static std::atomic<size_t> allocationCount = 0;
+
+void* operator new(size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	if (void* pointer = std::malloc(size ? size : 1))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, std::nothrow_t const&) noexcept
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	return std::malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, std::nothrow_t const&) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+	std::free(pointer);
+}
+
+size_t memory::getAllocationCount()
+{
+	return allocationCount.load(std::memory_order_relaxed);
+}
+#else
+size_t memory::getAllocationCount()
+{
+	return 0;
+}
+#endif
+
+size_t memory::getPeakResidentBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters = {};
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	rusage usage = {};
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+	// ru_maxrss is in kilobytes on linux
+	return (size_t)usage.ru_maxrss * 1024;
+#endif
+}
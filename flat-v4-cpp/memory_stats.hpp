@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+
+// process wide memory counters for the benchmarks. counting allocations replaces the global operator new,
+// which puts an atomic increment on every allocation of every thread, so it is only compiled into builds
+// that define FLC_COUNT_ALLOCATIONS, like msbuild /p:CountAllocations=true or -DFLC_COUNT_ALLOCATIONS
+namespace memory
+{
+#ifdef FLC_COUNT_ALLOCATIONS
+	constexpr bool countsAllocations = true;
+#else
+	constexpr bool countsAllocations = false;
+#endif
+
+	// 0 unless countsAllocations
+	size_t getAllocationCount();
+	size_t getPeakResidentBytes();
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+
+#include "ast.hpp"
+
+// operator and the resolved operand types, right is NONE for unary operators
+struct OperatorKey
+{
+	static constexpr TypeId NONE = (TypeId)UINT32_MAX;
+
+	Token op;
+	TypeId left, right;
+
+	bool operator==(OperatorKey const& other) const = default;
+};
+
+struct OperatorKeyHash
+{
+	size_t operator()(OperatorKey const& key) const
+	{
+		uint64_t hash = ((uint64_t)key.left << 32 | (uint64_t)key.right) * 0x9E3779B97F4A7C15;
+		return (size_t)(hash ^ (hash >> 29) ^ (uint64_t)key.op);
+	}
+};
+
+// memoizes operator resolution for one compilation, the same operator is
+// usually applied to the same few type combinations over and over. operators on builtin
+// operands are looked up in the intrinsic table instead, they are only counted here
+class OperatorCache
+{
+private:
+	std::unordered_map<OperatorKey, FunctionDeclaration*, OperatorKeyHash> entries;
+	size_t hits, misses, intrinsicLookups;
+
+public:
+	OperatorCache() :
+		hits(0),
+		misses(0),
+		intrinsicLookups(0)
+	{
+	}
+
+public:
+	// resolve is only called on a miss, a failed resolution (null) is cached as well
+	template<typename Fn>
+	FunctionDeclaration* get(OperatorKey const& key, Fn&& resolve)
+	{
+		auto it = entries.find(key);
+		if (it != entries.end())
+		{
+			hits++;
+			return it->second;
+		}
+
+		misses++;
+		return entries.try_emplace(key, resolve()).first->second;
+	}
+
+	// takes over the entries and counters of another cache, entries already present are kept
+	void merge(OperatorCache const& other)
+	{
+		entries.insert(other.entries.begin(), other.entries.end());
+		hits += other.hits;
+		misses += other.misses;
+		intrinsicLookups += other.intrinsicLookups;
+	}
+
+	inline void countIntrinsicLookup() { intrinsicLookups++; }
+
+	inline size_t getIntrinsicLookups() const { return intrinsicLookups; }
+	inline size_t getHits() const { return hits; }
+	inline size_t getMisses() const { return misses; }
+	inline size_t size() const { return entries.size(); }
+};
@@ -2,248 +2,247 @@
 #include "lexer.hpp"
 #include "ast.hpp"
 #include "type.hpp"
+#include "thread_pool.hpp"
+
+#include <exception>
 
 class Parser : public Lexer
 {
 private:
 	TypeContext& ctx;
+	SourceFile const& source;
 
-public:
-	Parser(TypeContext& ctx, std::string_view input, std::ostream& logStream) : 
-		Lexer(input, logStream),
-		ctx(ctx)
+	// nodes are allocated from the pool, which is handed over to the module once it is parsed
+	std::unique_ptr<PoolAllocator> allocator;
+
+	// child lists are collected on one stack and copied into the pool when they are complete
+	std::vector<AstNode*> nodeStack;
+
+	// left is the power an operator binds to its left operand with, 0 for tokens that are no binary operator.
+	// right is the minimum power of the operators in its right operand, left + 1 for left associative operators
+	struct BindingPower
 	{
-	}
+		uint8_t left, right;
+	};
 
-public:
-	std::shared_ptr<Expression> l0()
+	static constexpr std::pair<Token, uint8_t> binaryOperators[] =
 	{
-		auto begin = position;
-		if (match(Token::ParenOpen)) {
-			auto e = expression();
-			if (!expect(Token::ParenClose)) return nullptr;
-			return e;
-		} else if(match(Token::Integer)) {
-			return std::make_shared<IntegerExpression>(begin, position, integer());
-		} else if(match(Token::Identifier)) {
-			return std::make_shared<IdentifierExpression>(begin, position, identifier());
-		} else {
-			error("Invalid l0", true);
-			return nullptr;
-		}
-	}
+		{ Token::Assign, 1 },
+
+		{ Token::LogicalOr, 2 },
 
-	std::shared_ptr<Expression> l1()
+		{ Token::LogicalAnd, 3 },
+
+		{ Token::Equal, 4 },
+		{ Token::NotEqual, 4 },
+		{ Token::LessThan, 4 },
+		{ Token::GreaterThan, 4 },
+		{ Token::LessOrEqual, 4 },
+		{ Token::GreaterOrEqual, 4 },
+
+		{ Token::BitwiseAnd, 5 },
+		{ Token::BitwiseOr, 5 },
+		{ Token::BitwiseXor, 5 },
+
+		{ Token::ShiftLeft, 6 },
+		{ Token::ShiftRight, 6 },
+
+		{ Token::Plus, 7 },
+		{ Token::Minus, 7 },
+
+		{ Token::Multiply, 8 },
+		{ Token::Divide, 8 },
+		{ Token::Modulo, 8 },
+	};
+
+	static constexpr std::array<BindingPower, std::size(tokenNames)> buildBindingPowerTable()
 	{
-		auto begin = position;
-		auto e = l0();
-		while(true) {
-			if(match(Token::ParenOpen)) {
-				std::vector<std::shared_ptr<Expression>> args;
-				while(!match(Token::ParenClose) && !match(Token::Eof)) {
-					args.push_back(expression());
-					match(Token::Comma);
-				}
-				e = std::make_shared<CallExpression>(begin, position, e, args);
-			} else if(match(Token::BracketOpen)) {
-				std::vector<std::shared_ptr<Expression>> args;
-				while(!match(Token::BracketClose) && !match(Token::Eof)) {
-					args.push_back(expression());
-					match(Token::Comma);
-				}
-				e = std::make_shared<IndexExpression>(begin, position, e, args);
-			} else {
-				return e;
-			}
+		std::array<BindingPower, std::size(tokenNames)> table = {};
+		for (auto& [token, power] : binaryOperators)
+		{
+			// assignment is the only right associative operator
+			table[(size_t)token] = { power, (uint8_t)(token == Token::Assign ? power : power + 1) };
 		}
+		return table;
 	}
 
-	std::shared_ptr<Expression> l2()
+	static const std::array<BindingPower, std::size(tokenNames)> bindingPowers;
+
+public:
+	Parser(TypeContext& ctx, SourceFile const& source, DiagnosticEngine& diagnostics) : 
+		Lexer(source, diagnostics),
+		ctx(ctx),
+		source(source),
+		allocator(std::make_unique<PoolAllocator>())
 	{
-		auto begin = position;
-		if(match(Token::Plus)) {
-			return std::make_shared<UnaryExpression>(begin, position, Token::Plus, l2());
-		} else if(match(Token::Minus)) {
-			return std::make_shared<UnaryExpression>(begin, position, Token::Minus, l2());
-		} else if(match(Token::LogicalNot)) {
-			return std::make_shared<UnaryExpression>(begin, position, Token::LogicalNot, l2());
-		} else if(match(Token::BitwiseNot)) {
-			return std::make_shared<UnaryExpression>(begin, position, Token::BitwiseNot, l2());
-		} else {
-			return l1();
-		}
 	}
 
-	std::shared_ptr<Expression> l3()
+	// parses from the token buffer of another parser, used for the parallel declaration parsing
+	Parser(TypeContext& ctx, SourceFile const& source, DiagnosticEngine& diagnostics, std::span<TokenRecord const> tokens) : 
+		Lexer(source, diagnostics, tokens),
+		ctx(ctx),
+		source(source),
+		allocator(std::make_unique<PoolAllocator>())
 	{
-		auto begin = position;
-		auto e = l2();
-		while(true) {
-			if(match(Token::Multiply)) {
-				e = std::make_shared<BinaryExpression>(begin, position, Token::Multiply, e, l2());
-			} else if(match(Token::Divide)) {
-				e = std::make_shared<BinaryExpression>(begin, position, Token::Divide, e, l2());
-			} else if(match(Token::Modulo)) {
-				e = std::make_shared<BinaryExpression>(begin, position, Token::Modulo, e, l2());
-			} else {
-				return e;
-			}
-		}
 	}
 
-	std::shared_ptr<Expression> l4()
+private:
+	template<typename T, typename... Args>
+	T* make(Args&&... args)
 	{
-		auto begin = position;
-		auto e = l3();
-		while(true) {
-			if(match(Token::Plus)) {
-				e = std::make_shared<BinaryExpression>(begin, position, Token::Plus, e, l3());
-			} else if(match(Token::Minus)) {
-				e = std::make_shared<BinaryExpression>(begin, position, Token::Minus, e, l3());
-			} else {
-				return e;
-			}
-		}
+		return allocator->make<T>(std::forward<Args>(args)...);
 	}
 
-	std::shared_ptr<Expression> l5()
+	template<typename T>
+	std::span<T*> popNodes(size_t start)
 	{
-		auto begin = position;
-		auto e = l4();
-		while(true) {
-			if(match(Token::ShiftLeft)) {
-				e = std::make_shared<BinaryExpression>(begin, position, Token::ShiftLeft, e, l4());
-			} else if(match(Token::ShiftRight)) {
-				e = std::make_shared<BinaryExpression>(begin, position, Token::ShiftRight, e, l4());
-			} else {
-				return e;
-			}
-		}
+		auto count = nodeStack.size() - start;
+		if (count == 0)
+			return {};
+		auto nodes = std::span<T*>(static_cast<T**>(allocator->allocate(count * sizeof(T*), alignof(T*))), count);
+		for (size_t i = 0; i < count; i++)
+			nodes[i] = static_cast<T*>(nodeStack[start + i]);
+		nodeStack.resize(start);
+		return nodes;
 	}
 
-	std::shared_ptr<Expression> l6()
+public:
+	Expression* l0()
 	{
 		auto begin = position;
-		auto e = l5();
-		while(true) {
-			if(match(Token::BitwiseAnd)) {
-				e = std::make_shared<BinaryExpression>(begin, position, Token::BitwiseAnd, e, l5());
-			} else if(match(Token::BitwiseOr)) {
-				e = std::make_shared<BinaryExpression>(begin, position, Token::BitwiseOr, e, l5());
-			} else if(match(Token::BitwiseXor)) {
-				e = std::make_shared<BinaryExpression>(begin, position, Token::BitwiseXor, e, l5());
-			} else {
-				return e;
-			}
+		switch (lookahead()) {
+		case Token::ParenOpen: {
+			match(Token::ParenOpen);
+			auto e = expression();
+			if (!expect(Token::ParenClose)) return nullptr;
+			return e;
+		}
+		case Token::Integer: {
+			match(Token::Integer);
+			auto literal = integer();
+			auto suffixType = literal.suffix.empty() ? nullptr : ctx.getNamedType(literal.suffix);
+			return make<IntegerExpression>(begin, position, literal.value, suffixType);
+		}
+		case Token::Identifier:
+			match(Token::Identifier);
+			return make<IdentifierExpression>(begin, position, identifier());
+		default:
+			error("Invalid l0", true);
+			return nullptr;
 		}
 	}
 
-	std::shared_ptr<Expression> l7()
+	Expression* l1()
 	{
 		auto begin = position;
-		auto e = l6();
+		auto e = l0();
 		while(true) {
-			if(match(Token::Equal)) {
-				e = std::make_shared<BinaryExpression>(begin, position, Token::Equal, e, l6());
-			} else if(match(Token::NotEqual)) {
-				e = std::make_shared<BinaryExpression>(begin, position, Token::NotEqual, e, l6());
-			} else if(match(Token::LessThan)) {
-				e = std::make_shared<BinaryExpression>(begin, position, Token::LessThan, e, l6());
-			} else if(match(Token::GreaterThan)) {
-				e = std::make_shared<BinaryExpression>(begin, position, Token::GreaterThan, e, l6());
-			} else if(match(Token::LessOrEqual)) {
-				e = std::make_shared<BinaryExpression>(begin, position, Token::LessOrEqual, e, l6());
-			} else if(match(Token::GreaterOrEqual)) {
-				e = std::make_shared<BinaryExpression>(begin, position, Token::GreaterOrEqual, e, l6());
-			} else {
+			switch (lookahead()) {
+			case Token::ParenOpen: {
+				match(Token::ParenOpen);
+				auto args = nodeStack.size();
+				while(!match(Token::ParenClose) && !match(Token::Eof)) {
+					nodeStack.push_back(expression());
+					match(Token::Comma);
+				}
+				e = make<CallExpression>(begin, position, e, popNodes<Expression>(args));
+				break;
+			}
+			case Token::BracketOpen: {
+				match(Token::BracketOpen);
+				auto args = nodeStack.size();
+				while(!match(Token::BracketClose) && !match(Token::Eof)) {
+					nodeStack.push_back(expression());
+					match(Token::Comma);
+				}
+				e = make<IndexExpression>(begin, position, e, popNodes<Expression>(args));
+				break;
+			}
+			default:
 				return e;
 			}
 		}
 	}
 
-	std::shared_ptr<Expression> l8()
+	Expression* l2()
 	{
 		auto begin = position;
-		auto e = l7();
-		while(true) {
-			if(match(Token::LogicalAnd)) {
-				e = std::make_shared<BinaryExpression>(begin, position, Token::LogicalAnd, e, l7());
-			} else {
-				return e;
-			}
+		auto op = lookahead();
+		switch (op) {
+		case Token::Plus:
+		case Token::Minus:
+		case Token::LogicalNot:
+		case Token::BitwiseNot:
+			match(op);
+			return make<UnaryExpression>(begin, position, op, l2());
+		default:
+			return l1();
 		}
 	}
 
-	std::shared_ptr<Expression> l9()
+	// precedence climbing over bindingPowers, parses operators that bind at least as tight as minPower
+	Expression* binary(uint8_t minPower)
 	{
 		auto begin = position;
-		auto e = l8();
+		auto e = l2();
 		while(true) {
-			if(match(Token::LogicalOr)) {
-				e = std::make_shared<BinaryExpression>(begin, position, Token::LogicalOr, e, l8());
-			} else {
+			// the operand ended with a lookahead, so position already sits on the next token
+			auto op = peek();
+			auto power = bindingPowers[(size_t)op];
+			if (power.left < minPower)
 				return e;
-			}
+			match(op);
+			e = make<BinaryExpression>(begin, position, op, e, binary(power.right));
 		}
 	}
 
-	std::shared_ptr<Expression> l10()
+	Expression* expression()
 	{
-		auto begin = position;
-		auto e = l9();
-		if(match(Token::Assign)) {
-			return std::make_shared<BinaryExpression>(begin, position, Token::Assign, e, l10());
-		} else {
-			return e;
-		}
-	}
-
-	std::shared_ptr<Expression> expression()
-	{
-		return l10();
+		return binary(1);
 	}
 
-	std::shared_ptr<Statement> blockStatement()
+	Statement* blockStatement()
 	{
 		auto begin = position;
-		std::vector<std::shared_ptr<Statement>> statements;
+		auto statements = nodeStack.size();
 		while(!match(Token::BraceClose) && !match(Token::Eof)) {
-			statements.push_back(statement());
+			nodeStack.push_back(statement());
 		}
-		return std::make_shared<BlockStatement>(begin, position, statements);
+		return make<BlockStatement>(begin, position, popNodes<Statement>(statements));
 	}
 
-	std::shared_ptr<Statement> variableStatement()
+	Statement* variableStatement()
 	{
 		auto begin = position;
-		std::vector<std::string> names;
-		std::vector<std::shared_ptr<Expression>> values;
+		std::vector<Symbol> names;
+		auto values = nodeStack.size();
 		while(match(Token::Identifier)) {
 			names.push_back(identifier());
 			if (!expect(Token::Assign)) return nullptr;
-			values.push_back(expression());
-			match(Token::Comma);
+			nodeStack.push_back(expression());
+			if (!match(Token::Comma))
+				break;
 		}
-		return std::make_shared<VariableStatement>(begin, position, names, values);
+		return make<VariableStatement>(begin, position, allocator->copy(names), popNodes<Expression>(values));
 	}
 
-	std::shared_ptr<Statement> returnStatement()
+	Statement* returnStatement()
 	{
 		auto begin = position;
-		return std::make_shared<ReturnStatement>(begin, position, expression());
+		return make<ReturnStatement>(begin, position, expression());
 	}
 
-	std::shared_ptr<Statement> whileStatement()
+	Statement* whileStatement()
 	{
 		auto begin = position;
 		if (!expect(Token::ParenOpen)) return nullptr;
 		auto condition = expression();
 		if (!expect(Token::ParenClose)) return nullptr;
 		auto body = statement();
-		return std::make_shared<WhileStatement>(begin, position, condition, body);
+		return make<WhileStatement>(begin, position, condition, body);
 	}
 
-	std::shared_ptr<Statement> ifStatement()
+	Statement* ifStatement()
 	{
 		auto begin = position;
 		if (!expect(Token::ParenOpen)) return nullptr;
@@ -251,13 +250,13 @@ public:
 		if (!expect(Token::ParenClose)) return nullptr;
 		auto ifBody = statement();
 		if(match(Token::Else)) {
-			return std::make_shared<IfStatement>(begin, position, condition, ifBody, statement());
+			return make<IfStatement>(begin, position, condition, ifBody, statement());
 		} else {
-			return std::make_shared<IfStatement>(begin, position, condition, ifBody, nullptr);
+			return make<IfStatement>(begin, position, condition, ifBody, nullptr);
 		}
 	}
 
-	std::shared_ptr<Statement> statement()
+	Statement* statement()
 	{
 		if(match(Token::BraceOpen)) {
 			return blockStatement();
@@ -274,12 +273,12 @@ public:
 		}
 	}
 
-	std::shared_ptr<Declaration> functionDeclaration()
+	Declaration* functionDeclaration()
 	{
 		auto begin = position;
 		if (!expect(Token::Identifier)) return nullptr;
 		auto name = identifier();
-		std::vector<std::pair<std::string, Type*>> parameters;
+		std::vector<std::pair<Symbol, Type*>> parameters;
 		if (!expect(Token::ParenOpen)) return nullptr;
 		while(!match(Token::ParenClose) && !match(Token::Eof)) {
 			if (!expect(Token::Identifier)) return nullptr;
@@ -295,24 +294,123 @@ public:
 		}
 		if (!expect(Token::BraceOpen)) return nullptr;
 		auto body = blockStatement();
-		return std::make_shared<FunctionDeclaration>(begin, position, name, result, parameters, body);
+		return make<FunctionDeclaration>(begin, position, name, result, allocator->copy(parameters), body);
+	}
+
+	// parses the declarations up to the token with index end or the end of the input
+	std::vector<Declaration*> declarations(size_t begin, size_t end)
+	{
+		rewind(begin);
+		std::vector<Declaration*> declarations;
+		while(mark() < end) {
+			try {
+				if (match(Token::Eof)) break;
+				if (!expect(Token::Function)) break;
+				declarations.push_back(functionDeclaration());
+			} catch (CompilationError&) {
+				// drop the child lists of the function that was being parsed
+				nodeStack.clear();
+				// functions can not nest, so parsing resumes at the next fn keyword
+				if (!recover(Token::Function)) break;
+			}
+		}
+		return declarations;
+	}
+
+	std::unique_ptr<Module> module()
+	{
+		auto begin = position;
+		auto declarations = this->declarations(0, SIZE_MAX);
+		auto nodes = allocator->copy(declarations);
+		return std::make_unique<Module>(begin, position, nodes, std::move(allocator));
 	}
 
-	std::shared_ptr<Module> module()
+	// parses the declarations on the pool. a declaration can never consume a fn keyword outside of braces,
+	// and recovery stops at the next one, so splitting the input there gives the same module and errors as module()
+	std::unique_ptr<Module> module(ThreadPool& pool)
 	{
+		struct Batch
+		{
+			size_t begin = 0, end = 0;
+			std::unique_ptr<PoolAllocator> allocator = nullptr;
+			std::vector<Declaration*> declarations = {};
+			size_t position = 0;
+			std::exception_ptr error = nullptr;
+		};
+
 		auto begin = position;
-		std::vector<std::shared_ptr<Declaration>> declarations;
-		while(!match(Token::Eof)) {
-			if (!expect(Token::Function)) return nullptr;
-			declarations.push_back(functionDeclaration());
+		if (tokenView.empty())
+			tokenize();
+
+		// several batches per thread, so threads that got the long functions do not hold up the rest
+		auto starts = findDeclarations();
+		auto batchTokens = std::max<size_t>(tokenView.size() / (pool.size() * 16), 1);
+		std::vector<Batch> batches;
+		for (auto start : starts) {
+			if (!batches.empty() && start - batches.back().begin < batchTokens)
+				continue;
+			if (!batches.empty())
+				batches.back().end = start;
+			batches.push_back({ start, tokenView.size() });
+		}
+
+		for (auto& batch : batches) {
+			pool.submit([this, &batch] {
+				try {
+					Parser parser(ctx, source, diagnostics, tokenView);
+					batch.declarations = parser.declarations(batch.begin, batch.end);
+					batch.position = parser.position;
+					batch.allocator = std::move(parser.allocator);
+				} catch (...) {
+					batch.error = std::current_exception();
+				}
+			});
+		}
+		pool.wait();
+
+		std::vector<Declaration*> declarations;
+		for (auto& batch : batches) {
+			if (batch.error)
+				std::rethrow_exception(batch.error);
+			allocator->merge(*batch.allocator);
+			declarations.insert(declarations.end(), batch.declarations.begin(), batch.declarations.end());
 		}
-		return std::make_shared<Module>(begin, position, declarations);
+		position = batches.back().position;
+
+		auto nodes = allocator->copy(declarations);
+		return std::make_unique<Module>(begin, position, nodes, std::move(allocator));
+	}
+
+	// token indices of the fn keywords outside of braces, the first entry is always 0
+	std::vector<size_t> findDeclarations()
+	{
+		std::vector<size_t> starts = { 0 };
+		size_t depth = 0;
+		for (size_t i = 0; i < tokenView.size(); i++) {
+			switch (tokenView[i].kind) {
+			case Token::BraceOpen:
+				depth++;
+				break;
+			case Token::BraceClose:
+				// a stray closing brace ends no declaration, the module level reports it
+				if (depth > 0)
+					depth--;
+				break;
+			case Token::Function:
+				if (depth == 0 && i != 0)
+					starts.push_back(i);
+				break;
+			default:
+				break;
+			}
+		}
+		return starts;
 	}
 
 	Type* typeName()
 	{
 		if (!expect(Token::Identifier)) return nullptr;
-		Type* type = ctx.getNamedType(std::string(identifier()));
+		Type* type = ctx.getNamedType(identifier());
 		while(true) {
 			if(match(Token::Multiply)) {
 				type = ctx.getPointerType(type);
@@ -323,4 +421,6 @@ public:
 			}
 		}
 	}
-};
\ No newline at end of file
+};
+
+inline constexpr std::array<Parser::BindingPower, std::size(tokenNames)> Parser::bindingPowers = Parser::buildBindingPowerTable();
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include "peephole_optimizer.hpp"
+
+namespace
+{
+	using Code = std::vector<MachineInstruction>;
+
+	// mov [base + offset], a; mov b, [base + offset] -> mov [base + offset], a; mov b, a
+	bool storeLoad(Code& code)
+	{
+		auto& store = code[code.size() - 2];
+		auto& load = code.back();
+		if (store.op != MachineOp::MovRel32R || load.op != MachineOp::MovRRel32 || store.reg1 != load.reg2 || store.immediate != load.immediate)
+			return false;
+
+		load = { MachineOp::MovRR, load.reg1, store.reg2 };
+		return true;
+	}
+
+	// mov a, a
+	bool selfMove(Code& code)
+	{
+		if (code.back().op != MachineOp::MovRR || code.back().reg1 != code.back().reg2)
+			return false;
+
+		code.pop_back();
+		return true;
+	}
+
+	// mov a, b; mov b, a -> mov a, b
+	bool moveBack(Code& code)
+	{
+		auto& first = code[code.size() - 2];
+		auto& second = code.back();
+		if (first.op != MachineOp::MovRR || second.op != MachineOp::MovRR || first.reg1 != second.reg2 || first.reg2 != second.reg1)
+			return false;
+
+		code.pop_back();
+		return true;
+	}
+
+	// mov a, imm64 -> mov a32, imm32 for values that zero extend from 32 bit, mov a, imm32 for ones that sign extend
+	bool narrowImmediate(Code& code)
+	{
+		auto& instruction = code.back();
+		if (instruction.op != MachineOp::MovRIm64)
+			return false;
+
+		auto value = (uint64_t)instruction.immediate;
+		if (value <= UINT32_MAX)
+			instruction.op = MachineOp::MovR32Im32;
+		else if (instruction.immediate >= INT32_MIN && instruction.immediate < 0)
+			instruction.op = MachineOp::MovRIm32;
+		else
+			return false;
+		return true;
+	}
+
+	// xor a, a; cmp x, y; setcc a; (mov)*; test b, b; jz/jnz target -> xor a, a; cmp x, y; setcc a; (mov)*; j(n)cc target
+	// where b is a copy of a. the moves leave the flags of the compare alone, the value of the compare is kept
+	bool branchOnCompare(Code& code)
+	{
+		static constexpr size_t MAX_MOVES = 4;
+
+		auto& test = code[code.size() - 2];
+		auto& jump = code.back();
+		if (test.op != MachineOp::TestRR || test.reg1 != test.reg2 || jump.op != MachineOp::JmpCC || (jump.condition != x64::E && jump.condition != x64::NE))
+			return false;
+
+		// follows the copies back to the setcc, the register is the one that holds the tested value before each move
+		auto reg = test.reg1;
+		auto i = code.size() - 2;
+		for (size_t moves = 0; i > 0 && moves <= MAX_MOVES; moves++)
+		{
+			auto& instruction = code[--i];
+			if (instruction.op == MachineOp::SetCC && instruction.reg1 == reg)
+				break;
+			else if (instruction.op == MachineOp::MovRR && instruction.reg1 == reg)
+				reg = instruction.reg2;
+			else if ((instruction.op != MachineOp::MovRR && instruction.op != MachineOp::MovRRel32 && instruction.op != MachineOp::MovRel32R) || (instruction.op == MachineOp::MovRRel32 && instruction.reg1 == reg))
+				return false;
+		}
+
+		// setcc only writes the low byte, the xor before the compare clears the rest
+		if (i < 2 || code[i].op != MachineOp::SetCC || code[i].reg1 != reg || code[i - 1].op != MachineOp::CmpRR
+			|| code[i - 2].op != MachineOp::XorRR || code[i - 2].reg1 != reg || code[i - 2].reg2 != reg)
+			return false;
+
+		auto condition = (jump.condition == x64::NE) ? code[i].condition : x64::negate(code[i].condition);
+		auto target = jump.label;
+		code.pop_back();
+		code.back() = { MachineOp::JmpCC, 0, 0, 0, condition, target };
+		return true;
+	}
+
+	struct Rule
+	{
+		PeepholeRule rule;
+
+		// number of instructions at the end of the output the rule looks at first
+		size_t window;
+		bool (*apply)(Code& code);
+	};
+
+	constexpr Rule rules[] =
+	{
+		{ PeepholeRule::StoreLoad, 2, storeLoad },
+		{ PeepholeRule::SelfMove, 1, selfMove },
+		{ PeepholeRule::MoveBack, 2, moveBack },
+		{ PeepholeRule::NarrowImmediate, 1, narrowImmediate },
+		{ PeepholeRule::BranchOnCompare, 2, branchOnCompare },
+	};
+}
+
+void PeepholeOptimizer::optimize(std::vector<MachineInstruction>& code)
+{
+	output.clear();
+	for (auto& instruction : code)
+	{
+		output.push_back(instruction);
+		while (rewrite())
+			;
+	}
+	code.swap(output);
+}
+
+bool PeepholeOptimizer::rewrite()
+{
+	for (auto& rule : rules)
+	{
+		if (output.size() >= rule.window && rule.apply(output))
+		{
+			counts[(size_t)rule.rule]++;
+			return true;
+		}
+	}
+	return false;
+}
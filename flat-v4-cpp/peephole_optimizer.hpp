@@ -0,0 +1,44 @@
+#pragma once
+#include <array>
+#include <vector>
+
+#include "code_generator.hpp"
+
+enum class PeepholeRule : uint8_t
+{
+	StoreLoad,
+	SelfMove,
+	MoveBack,
+	NarrowImmediate,
+	BranchOnCompare,
+	Count,
+};
+
+static constexpr const char* peepholeRuleNames[] =
+{
+	"store-load",
+	"self-move",
+	"move-back",
+	"narrow-immediate",
+	"branch-on-compare",
+};
+
+// rewrites short sequences in the instructions of one function before they are encoded. every instruction is
+// appended to the output, then the rules are matched against the end of the output until none applies, so the
+// result of one rewrite can be rewritten by the next. a window never spans a label, other code may jump there
+class PeepholeOptimizer
+{
+private:
+	std::vector<MachineInstruction> output;
+	std::array<size_t, (size_t)PeepholeRule::Count> counts = {};
+
+public:
+	void optimize(std::vector<MachineInstruction>& code);
+
+	inline size_t getCount(PeepholeRule rule) const { return counts[(size_t)rule]; }
+	inline void resetCounts() { counts = {}; }
+
+private:
+	// tries the rules on the end of the output, true if one of them rewrote it
+	bool rewrite();
+};
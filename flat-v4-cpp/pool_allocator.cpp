@@ -0,0 +1,59 @@
+#include "pool_allocator.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+PoolAllocator::PoolAllocator() :
+	blockPosition(nullptr),
+	blockRemaining(0),
+	allocatedBytes(0)
+{
+}
+
+PoolAllocator::~PoolAllocator()
+{
+	for (auto it = destructors.rbegin(); it != destructors.rend(); it++)
+		it->destroy(it->object);
+}
+
+void* PoolAllocator::allocate(size_t size, size_t alignment)
+{
+	size_t padding = (0 - (uintptr_t)blockPosition) & (alignment - 1);
+	if (padding + size > blockRemaining)
+	{
+		// oversized requests get a block of their own, the rest of the current block is given up
+		size_t blockSize = std::max(BLOCK_SIZE, size + alignment);
+		blocks.push_back(std::unique_ptr<std::byte[]>(new std::byte[blockSize]));
+		blockPosition = blocks.back().get();
+		blockRemaining = blockSize;
+		padding = (0 - (uintptr_t)blockPosition) & (alignment - 1);
+	}
+
+	auto pointer = blockPosition + padding;
+	blockPosition += padding + size;
+	blockRemaining -= padding + size;
+	allocatedBytes += size;
+	return pointer;
+}
+
+std::string_view PoolAllocator::copy(std::string_view text)
+{
+	if (text.empty())
+		return {};
+	auto data = static_cast<char*>(allocate(text.length(), 1));
+	std::memcpy(data, text.data(), text.length());
+	return std::string_view(data, text.length());
+}
+
+void PoolAllocator::merge(PoolAllocator& other)
+{
+	blocks.insert(blocks.end(), std::make_move_iterator(other.blocks.begin()), std::make_move_iterator(other.blocks.end()));
+	destructors.insert(destructors.end(), other.destructors.begin(), other.destructors.end());
+	allocatedBytes += other.allocatedBytes;
+
+	other.blocks.clear();
+	other.destructors.clear();
+	other.blockPosition = nullptr;
+	other.blockRemaining = 0;
+	other.allocatedBytes = 0;
+}
@@ -1,6 +1,74 @@
 #pragma once
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
-struct PoolAllocator
+// bump allocator that owns everything allocated from it, all memory is released at once when it is destroyed
+class PoolAllocator
 {
+private:
+	static constexpr size_t BLOCK_SIZE = 64 * 1024;
 
-};
\ No newline at end of file
+	struct Destructor
+	{
+		void* object;
+		void (*destroy)(void* object);
+	};
+
+	std::vector<std::unique_ptr<std::byte[]>> blocks;
+	std::byte* blockPosition;
+	size_t blockRemaining;
+	size_t allocatedBytes;
+
+	// objects that need their destructor run, destroyed in reverse order of construction
+	std::vector<Destructor> destructors;
+
+public:
+	PoolAllocator();
+	~PoolAllocator();
+
+	PoolAllocator(PoolAllocator const&) = delete;
+	PoolAllocator& operator=(PoolAllocator const&) = delete;
+
+public:
+	void* allocate(size_t size, size_t alignment);
+
+	template<typename T, typename... Args>
+	T* make(Args&&... args)
+	{
+		auto object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+		if constexpr (!std::is_trivially_destructible_v<T>)
+			destructors.push_back({ object, [](void* object) { static_cast<T*>(object)->~T(); } });
+		return object;
+	}
+
+	template<typename T>
+	std::span<T> copy(std::span<T const> values)
+	{
+		static_assert(std::is_trivially_destructible_v<T>, "pool arrays are never destroyed");
+		if (values.empty())
+			return {};
+		auto data = static_cast<T*>(allocate(values.size() * sizeof(T), alignof(T)));
+		std::uninitialized_copy(values.begin(), values.end(), data);
+		return std::span<T>(data, values.size());
+	}
+
+	template<typename T>
+	std::span<T> copy(std::vector<T> const& values)
+	{
+		return copy(std::span<T const>(values));
+	}
+
+	std::string_view copy(std::string_view text);
+
+	// takes over the memory and objects of other, which is left empty
+	void merge(PoolAllocator& other);
+
+	inline size_t getAllocatedBytes() const { return allocatedBytes; }
+	inline size_t getBlockCount() const { return blocks.size(); }
+};
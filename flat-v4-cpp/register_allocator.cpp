@@ -0,0 +1,229 @@
+#include "register_allocator.hpp"
+#include <algorithm>
+#include <bit>
+
+RegisterAllocation RegisterAllocator::allocate(IrFunction const& function)
+{
+	computeIntervals(function);
+	std::sort(intervals.begin(), intervals.end(), [](Interval const& a, Interval const& b) {
+		return a.begin < b.begin;
+	});
+
+	RegisterAllocation allocation = { std::vector<Location>(function.valueTypes.size(), { Location::STACK, 0 }), 0, {} };
+	auto spill = [&](IrValue value) {
+		allocation.locations[(size_t)value] = { Location::STACK, allocation.spillSlots++ };
+		spilled++;
+	};
+
+	// active intervals sorted by their end, free registers in the order of the pool
+	std::vector<Interval const*> active;
+	std::vector<uint8_t> free(pool.begin(), pool.end());
+	std::vector<bool> saved(16, false);
+
+	for (auto& interval : intervals)
+	{
+		// an interval that ends at the position another one begins still overlaps it, the operands
+		// of an instruction are read at the same position its result is written
+		while (!active.empty() && active.front()->end < interval.begin)
+		{
+			free.push_back(allocation.locations[(size_t)active.front()->value].reg);
+			active.erase(active.begin());
+		}
+		std::sort(free.begin(), free.end(), [&](uint8_t a, uint8_t b) {
+			return std::find(pool.begin(), pool.end(), a) < std::find(pool.begin(), pool.end(), b);
+		});
+
+		auto candidate = std::find_if(free.begin(), free.end(), [&](uint8_t reg) {
+			return !interval.crossesCall || isCalleeSaved(reg);
+		});
+
+		if (candidate != free.end())
+		{
+			allocation.locations[(size_t)interval.value] = { *candidate, 0 };
+			free.erase(candidate);
+		}
+		else
+		{
+			// the active interval that ends last and holds a register this one can use
+			Interval const* victim = nullptr;
+			for (auto other : active)
+			{
+				if (!interval.crossesCall || isCalleeSaved(allocation.locations[(size_t)other->value].reg))
+					victim = other;
+			}
+
+			if (victim && victim->end > interval.end)
+			{
+				allocation.locations[(size_t)interval.value] = allocation.locations[(size_t)victim->value];
+				spill(victim->value);
+				active.erase(std::find(active.begin(), active.end(), victim));
+			}
+			else
+			{
+				spill(interval.value);
+				continue;
+			}
+		}
+
+		auto reg = allocation.locations[(size_t)interval.value].reg;
+		if (isCalleeSaved(reg) && !saved[reg])
+		{
+			saved[reg] = true;
+			allocation.savedRegisters.push_back(reg);
+		}
+		active.insert(std::upper_bound(active.begin(), active.end(), &interval, [](Interval const* a, Interval const* b) {
+			return a->end < b->end;
+		}), &interval);
+	}
+
+	return allocation;
+}
+
+bool RegisterAllocator::isCalleeSaved(uint8_t reg)
+{
+	switch (reg)
+	{
+	case x64::RBX:
+	case x64::RBP:
+	case x64::RSI:
+	case x64::RDI:
+	case x64::R12:
+	case x64::R13:
+	case x64::R14:
+	case x64::R15:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void RegisterAllocator::computeIntervals(IrFunction const& function)
+{
+	auto valueCount = function.valueTypes.size();
+	auto blockCount = function.blocks.size();
+	auto words = (valueCount + 63) / 64;
+
+	// the phis of a block are defined at its first position, the instructions follow it
+	std::vector<uint32_t> blockBegin(blockCount), blockEnd(blockCount), calls;
+	uint32_t position = 0;
+	for (size_t i = 0; i < blockCount; i++)
+	{
+		blockBegin[i] = position;
+		for (auto& instruction : function.blocks[i].instructions)
+		{
+			position++;
+			if (instruction.op == IrOp::Call)
+				calls.push_back(position);
+		}
+		blockEnd[i] = position++;
+	}
+
+	// upward exposed uses and definitions of every block. phi operands are used at the end of the predecessor
+	std::vector<uint64_t> uses(blockCount * words, 0), definitions(blockCount * words, 0);
+	auto set = [&](std::vector<uint64_t>& bits, size_t block, IrValue value) {
+		bits[block * words + (size_t)value / 64] |= uint64_t(1) << ((size_t)value % 64);
+	};
+	auto test = [&](std::vector<uint64_t> const& bits, size_t block, IrValue value) {
+		return (bits[block * words + (size_t)value / 64] >> ((size_t)value % 64)) & 1;
+	};
+
+	for (size_t i = 0; i < blockCount; i++)
+	{
+		auto& block = function.blocks[i];
+		for (auto& phi : block.phis)
+			set(definitions, i, phi.result);
+		for (auto& instruction : block.instructions)
+		{
+			for (auto operand : function.getOperands(instruction))
+			{
+				if (!test(definitions, i, operand))
+					set(uses, i, operand);
+			}
+			if (instruction.result != IrFunction::NONE)
+				set(definitions, i, instruction.result);
+		}
+		for (auto successor : function.getSuccessors((IrBlockId)i))
+		{
+			auto& target = function.getBlock(successor);
+			auto index = std::find(target.predecessors.begin(), target.predecessors.end(), (IrBlockId)i) - target.predecessors.begin();
+			for (auto& phi : target.phis)
+			{
+				auto operand = function.getOperands(phi)[index];
+				if (!test(definitions, i, operand))
+					set(uses, i, operand);
+			}
+		}
+	}
+
+	// live in = uses | (live out & ~definitions), live out is the union of the live in sets of the successors
+	std::vector<uint64_t> liveIn(blockCount * words, 0), liveOut(blockCount * words, 0);
+	for (bool changed = true; changed; )
+	{
+		changed = false;
+		for (size_t i = blockCount; i-- > 0; )
+		{
+			for (size_t w = 0; w < words; w++)
+			{
+				uint64_t out = 0;
+				for (auto successor : function.getSuccessors((IrBlockId)i))
+					out |= liveIn[(size_t)successor * words + w];
+				auto in = uses[i * words + w] | (out & ~definitions[i * words + w]);
+
+				changed |= (in != liveIn[i * words + w]);
+				liveOut[i * words + w] = out;
+				liveIn[i * words + w] = in;
+			}
+		}
+	}
+
+	// one interval per value over every position it is live at
+	std::vector<uint32_t> begin(valueCount, UINT32_MAX), end(valueCount, 0);
+	auto extend = [&](IrValue value, uint32_t from, uint32_t to) {
+		begin[(size_t)value] = std::min(begin[(size_t)value], from);
+		end[(size_t)value] = std::max(end[(size_t)value], to);
+	};
+
+	for (size_t i = 0; i < blockCount; i++)
+	{
+		auto& block = function.blocks[i];
+		for (auto& phi : block.phis)
+			extend(phi.result, blockBegin[i], blockBegin[i]);
+		for (size_t j = 0; j < block.instructions.size(); j++)
+		{
+			auto& instruction = block.instructions[j];
+			auto at = blockBegin[i] + 1 + (uint32_t)j;
+			for (auto operand : function.getOperands(instruction))
+				extend(operand, at, at);
+			if (instruction.result != IrFunction::NONE)
+				extend(instruction.result, at, at);
+		}
+
+		// the phi copies of an edge are made at the terminator of its source
+		for (auto successor : function.getSuccessors((IrBlockId)i))
+		{
+			auto& target = function.getBlock(successor);
+			auto index = std::find(target.predecessors.begin(), target.predecessors.end(), (IrBlockId)i) - target.predecessors.begin();
+			for (auto& phi : target.phis)
+				extend(function.getOperands(phi)[index], blockEnd[i], blockEnd[i]);
+		}
+
+		for (size_t w = 0; w < words; w++)
+		{
+			for (auto bits = liveIn[i * words + w]; bits; bits &= bits - 1)
+				extend((IrValue)(w * 64 + std::countr_zero(bits)), blockBegin[i], blockBegin[i]);
+			for (auto bits = liveOut[i * words + w]; bits; bits &= bits - 1)
+				extend((IrValue)(w * 64 + std::countr_zero(bits)), blockBegin[i], blockEnd[i]);
+		}
+	}
+
+	intervals.clear();
+	for (size_t value = 0; value < valueCount; value++)
+	{
+		if (begin[value] == UINT32_MAX)
+			continue;
+
+		// a value that is only used by a call ends there, the result of a call begins there
+		auto call = std::upper_bound(calls.begin(), calls.end(), begin[value]);
+		intervals.push_back({ (IrValue)value, begin[value], end[value], call != calls.end() && *call < end[value] });
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <span>
+#include <vector>
+
+#include "ir.hpp"
+#include "code_generator.hpp"
+
+// where a value is kept from its definition to its last use
+struct Location
+{
+	static constexpr uint8_t STACK = 0xFF;
+
+	// x64::Reg, or STACK for values in a spill slot
+	uint8_t reg;
+	uint32_t slot;
+
+	inline bool isRegister() const { return reg != STACK; }
+	inline bool operator==(Location const& other) const { return reg == other.reg && (isRegister() || slot == other.slot); }
+};
+
+struct RegisterAllocation
+{
+	// indexed by IrValue
+	std::vector<Location> locations;
+	uint32_t spillSlots;
+
+	// the callee saved registers the function uses, the prolog saves them and the epilog restores them
+	std::vector<uint8_t> savedRegisters;
+};
+
+// linear scan over live intervals, as in "Linear Scan Register Allocation" by Poletto and Sarkar. every value
+// has one interval from its first to its last live position in block order. values that are live across a call
+// only get callee saved registers, the others prefer caller saved ones, so the prolog has less to save.
+// if no register is left, the interval that ends last is spilled
+class RegisterAllocator
+{
+public:
+	// RAX, RCX and RDX are left to the instruction selector for division, shift counts, compares and phi cycles.
+	// caller saved registers come first. RSI and RDI are callee saved in the win64 convention
+	static constexpr uint8_t registers[] =
+	{
+		x64::R8, x64::R9, x64::R10, x64::R11,
+		x64::RBX, x64::RSI, x64::RDI, x64::R12, x64::R13, x64::R14, x64::R15,
+	};
+
+private:
+	struct Interval
+	{
+		IrValue value;
+		uint32_t begin, end;
+		bool crossesCall;
+	};
+
+	std::span<uint8_t const> pool;
+	std::vector<Interval> intervals;
+
+	size_t spilled;
+
+public:
+	// an empty pool spills every value
+	RegisterAllocator(std::span<uint8_t const> pool = registers) :
+		pool(pool),
+		spilled(0)
+	{
+	}
+
+public:
+	RegisterAllocation allocate(IrFunction const& function);
+
+	// number of values spilled over all functions so far
+	inline size_t getSpilled() const { return spilled; }
+
+	static bool isCalleeSaved(uint8_t reg);
+
+private:
+	// numbers the instructions in block order and computes the interval of every value from the live sets of the blocks
+	void computeIntervals(IrFunction const& function);
+};
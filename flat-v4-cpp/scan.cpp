@@ -0,0 +1,207 @@
+#include "scan.hpp"
+#include <bit>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define SCAN_X64
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// msvc allows avx2 intrinsics in any function, gcc and clang need the target enabled per function
+#if defined(SCAN_X64) && (defined(__GNUC__) || defined(__clang__))
+#define SCAN_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SCAN_TARGET_AVX2
+#endif
+
+namespace scan
+{
+	static bool isWhitespace(char c) { return (c == ' ' || c == '\t' || c == '\r' || c == '\n'); }
+	static bool isDigit(char c) { return (c >= '0' && c <= '9'); }
+	static bool isIdentifier(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || (c == '_'); }
+
+	static size_t skipWhitespaceScalar(char const* data, size_t position, size_t length)
+	{
+		while (position < length && isWhitespace(data[position]))
+			position++;
+		return position;
+	}
+
+	static size_t skipDigitsScalar(char const* data, size_t position, size_t length)
+	{
+		while (position < length && isDigit(data[position]))
+			position++;
+		return position;
+	}
+
+	static size_t skipIdentifierScalar(char const* data, size_t position, size_t length)
+	{
+		while (position < length && isIdentifier(data[position]))
+			position++;
+		return position;
+	}
+
+#ifdef SCAN_X64
+	// the class masks compare signed bytes, bytes >= 0x80 are negative and never match
+
+	static __m128i whitespaceMask(__m128i chunk)
+	{
+		return _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))),
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'))));
+	}
+
+	static __m128i digitMask(__m128i chunk)
+	{
+		return _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(chunk, _mm_set1_epi8('9' + 1)));
+	}
+
+	static __m128i identifierMask(__m128i chunk)
+	{
+		auto lower = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+		auto letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+		auto underscore = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('_'));
+		return _mm_or_si128(_mm_or_si128(letter, underscore), digitMask(chunk));
+	}
+
+	// most runs are short, so the first bytes are checked one at a time before
+	// switching to vector loads
+	static constexpr size_t scalarPrefix = 8;
+
+	template<size_t(*Scalar)(char const*, size_t, size_t)>
+	static bool skipPrefix(char const* data, size_t& position, size_t length)
+	{
+		size_t end = (length - position > scalarPrefix) ? position + scalarPrefix : length;
+		position = Scalar(data, position, end);
+		return position < end || position == length;
+	}
+
+	template<__m128i(*Mask)(__m128i), size_t(*Tail)(char const*, size_t, size_t)>
+	static size_t skipSse2(char const* data, size_t position, size_t length)
+	{
+		if (skipPrefix<Tail>(data, position, length))
+			return position;
+
+		while (position + 16 <= length)
+		{
+			auto chunk = _mm_loadu_si128((__m128i const*)(data + position));
+			uint32_t outside = ~(uint32_t)_mm_movemask_epi8(Mask(chunk)) & 0xFFFF;
+			if (outside)
+				return position + std::countr_zero(outside);
+			position += 16;
+		}
+
+		return Tail(data, position, length);
+	}
+
+	SCAN_TARGET_AVX2 static __m256i whitespaceMask(__m256i chunk)
+	{
+		return _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t'))),
+			_mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n'))));
+	}
+
+	SCAN_TARGET_AVX2 static __m256i digitMask(__m256i chunk)
+	{
+		return _mm256_and_si256(_mm256_cmpgt_epi8(chunk, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), chunk));
+	}
+
+	SCAN_TARGET_AVX2 static __m256i identifierMask(__m256i chunk)
+	{
+		auto lower = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+		auto letter = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+		auto underscore = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('_'));
+		return _mm256_or_si256(_mm256_or_si256(letter, underscore), digitMask(chunk));
+	}
+
+	template<__m256i(*Mask)(__m256i), size_t(*Tail)(char const*, size_t, size_t)>
+	SCAN_TARGET_AVX2 static size_t skipAvx2(char const* data, size_t position, size_t length)
+	{
+		if (skipPrefix<Tail>(data, position, length))
+			return position;
+
+		while (position + 32 <= length)
+		{
+			auto chunk = _mm256_loadu_si256((__m256i const*)(data + position));
+			uint32_t outside = ~(uint32_t)_mm256_movemask_epi8(Mask(chunk));
+			if (outside)
+				return position + std::countr_zero(outside);
+			position += 32;
+		}
+
+		return Tail(data, position, length);
+	}
+
+	static bool cpuSupportsAvx2()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+
+		// avx2 also needs the os to save the ymm registers (osxsave and xcr0 bits 1 and 2)
+		__cpuid(info, 1);
+		if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 0x06) != 0x06)
+			return false;
+
+		__cpuidex(info, 7, 0);
+		return info[1] & (1 << 5);
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+#endif
+
+	static Kernels makeKernels(Kernel kernel)
+	{
+		switch (kernel)
+		{
+#ifdef SCAN_X64
+		case Kernel::Sse2:
+			return { kernel,
+				&skipSse2<whitespaceMask, skipWhitespaceScalar>,
+				&skipSse2<digitMask, skipDigitsScalar>,
+				&skipSse2<identifierMask, skipIdentifierScalar> };
+		case Kernel::Avx2:
+			return { kernel,
+				&skipAvx2<whitespaceMask, skipWhitespaceScalar>,
+				&skipAvx2<digitMask, skipDigitsScalar>,
+				&skipAvx2<identifierMask, skipIdentifierScalar> };
+#endif
+		default:
+			return { Kernel::Scalar, &skipWhitespaceScalar, &skipDigitsScalar, &skipIdentifierScalar };
+		}
+	}
+
+	Kernel getBestKernel()
+	{
+#ifdef SCAN_X64
+		static const Kernel best = cpuSupportsAvx2() ? Kernel::Avx2 : Kernel::Sse2;
+		return best;
+#else
+		return Kernel::Scalar;
+#endif
+	}
+
+	static Kernels& currentKernels()
+	{
+		static Kernels kernels = makeKernels(getBestKernel());
+		return kernels;
+	}
+
+	Kernels const& getKernels()
+	{
+		return currentKernels();
+	}
+
+	void selectKernel(Kernel kernel)
+	{
+		if ((size_t)kernel > (size_t)getBestKernel())
+			kernel = getBestKernel();
+		currentKernels() = makeKernels(kernel);
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+
+// run scanning kernels for the lexer. each function returns the index of the first byte
+// at or after position that does not belong to the character class, or length.
+namespace scan
+{
+	enum class Kernel
+	{
+		Scalar,
+		Sse2,
+		Avx2,
+	};
+
+	static constexpr const char* kernelNames[] =
+	{
+		"scalar",
+		"sse2",
+		"avx2",
+	};
+
+	using ScanFunction = size_t(*)(char const* data, size_t position, size_t length);
+
+	struct Kernels
+	{
+		Kernel kernel;
+		ScanFunction skipWhitespace;
+		ScanFunction skipDigits;
+		ScanFunction skipIdentifier;
+	};
+
+	// best kernel supported by the cpu, detected once
+	Kernel getBestKernel();
+
+	// kernels used by newly constructed lexers, defaults to getBestKernel(),
+	// selecting a kernel the cpu does not support falls back to the best one
+	Kernels const& getKernels();
+	void selectKernel(Kernel kernel);
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <vector>
+
+#include "interner.hpp"
+#include "type.hpp"
+
+// locals of the function that is being checked or generated. variables are pushed as they are declared
+// and dropped when their block ends, lookups scan backwards so inner declarations shadow outer ones
+class ScopeStack
+{
+public:
+	struct Entry
+	{
+		Symbol name;
+		Type* type;
+		size_t slot;
+	};
+
+private:
+	std::vector<Entry> entries;
+
+	// entry count at the start of each open scope
+	std::vector<size_t> scopes;
+
+public:
+	inline void clear()
+	{
+		entries.clear();
+		scopes.clear();
+	}
+
+	inline void pushScope()
+	{
+		scopes.push_back(entries.size());
+	}
+
+	inline void popScope()
+	{
+		entries.resize(scopes.back());
+		scopes.pop_back();
+	}
+
+	// returns false if the name is already declared in the innermost scope
+	inline bool declare(Symbol name, Type* type, size_t slot = 0)
+	{
+		if (isDeclaredInScope(name))
+			return false;
+		entries.push_back({ name, type, slot });
+		return true;
+	}
+
+	inline bool isDeclaredInScope(Symbol name) const
+	{
+		auto begin = scopes.empty() ? 0 : scopes.back();
+		for (size_t i = entries.size(); i > begin; i--)
+		{
+			if (entries[i - 1].name == name)
+				return true;
+		}
+		return false;
+	}
+
+	// returns null if the name is not declared in any open scope
+	inline Entry const* find(Symbol name) const
+	{
+		for (size_t i = entries.size(); i > 0; i--)
+		{
+			if (entries[i - 1].name == name)
+				return &entries[i - 1];
+		}
+		return nullptr;
+	}
+
+	inline size_t size() const { return entries.size(); }
+};
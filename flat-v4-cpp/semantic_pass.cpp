@@ -1,4 +1,6 @@
 #include "semantic_pass.hpp"
+#include <algorithm>
+#include <exception>
 #include <iostream>
 
 void SemanticValidationPass::extractFunctions(Module* node)
@@ -8,80 +10,180 @@ void SemanticValidationPass::extractFunctions(Module* node)
 
 void SemanticValidationPass::validateFunctions()
 {
-	for (auto& cluster : functions)
-	{
-		for (auto& function : cluster.second)
-		{
-			functionResult = function.result;
+	for (auto function : functions.getFunctions())
+		validateFunction(function);
+}
 
-			// make parameters locally accessible
-			localVariables.clear();
-			for (auto& param : function.parameters)
+void SemanticValidationPass::validateFunctions(ThreadPool& pool)
+{
+	struct Batch
+	{
+		size_t begin = 0, end = 0;
+		std::unique_ptr<DiagnosticEngine> diagnostics = nullptr;
+		OperatorCache operatorCache = {};
+		std::exception_ptr error = nullptr;
+	};
+
+	// several batches per thread, so threads that got the long functions do not hold up the rest
+	auto& all = functions.getFunctions();
+	auto batchSize = std::max<size_t>(all.size() / (pool.size() * 16), 1);
+	std::vector<Batch> batches;
+	for (size_t begin = 0; begin < all.size(); begin += batchSize)
+		batches.push_back({ begin, std::min(begin + batchSize, all.size()) });
+
+	for (auto& batch : batches)
+	{
+		pool.submit([this, &all, &batch] {
+			try
 			{
-				localVariables.try_emplace(param.first, param.second);
+				batch.diagnostics = std::make_unique<DiagnosticEngine>(diagnostics.source, diagnostics.logStream);
+				SemanticValidationPass pass(typeCtx, *batch.diagnostics, functions);
+				for (size_t i = batch.begin; i < batch.end; i++)
+					pass.validateFunction(all[i]);
+				batch.operatorCache = std::move(pass.operatorCache);
 			}
+			catch (...)
+			{
+				batch.error = std::current_exception();
+			}
+		});
+	}
+	pool.wait();
+
+	for (auto& batch : batches)
+	{
+		if (batch.error)
+			std::rethrow_exception(batch.error);
+		diagnostics.append(*batch.diagnostics);
+		operatorCache.merge(batch.operatorCache);
+	}
+}
+
+void SemanticValidationPass::validateFunction(FunctionDeclaration* function)
+{
+	functionResult = function->result;
+
+	try
+	{
+		// parameters share the outermost scope with the locals of the function body
+		localVariables.clear();
+		localVariables.pushScope();
+		for (auto& param : function->parameters)
+		{
+			if (!localVariables.declare(param.first, param.second))
+				reportError(function, "Parameter is already defined");
+		}
+
+		if (function->body->kind == AstKind::BlockStatement)
+			validateStatements(static_cast<BlockStatement*>(function->body)->statements);
+		else
+			dispatch(function->body);
+	}
+	catch (CompilationError&)
+	{
+		// already reported, continue with the next function
+	}
+}
 
-			AstVisitor::visit(function.body.get());
+void SemanticValidationPass::validateStatements(std::span<Statement*> statements)
+{
+	for (auto& statement : statements)
+	{
+		try
+		{
+			dispatch(statement);
+		}
+		catch (CompilationError&)
+		{
+			// already reported, continue with the next statement
 		}
 	}
 }
 
 void SemanticValidationPass::visit(IntegerExpression* node)
 {
-	expressionResult = typeCtx.getNamedType("i64");
+	// literals without a suffix take the type the context expects if their value fits it, i64 otherwise
+	auto negated = negatedLiteral;
+	negatedLiteral = false;
+
+	auto type = node->suffixType;
+	if (!type)
+		type = (expectedType && literalFits(node->value, expectedType, negated)) ? expectedType : integerType;
+
+	if (!literalFits(node->value, type, negated))
+		reportError(node, "Integer literal out of range");
+	setResult(node, type);
 }
 
 void SemanticValidationPass::visit(IdentifierExpression* node)
 {
-	if (!localVariables.contains(node->value))
+	auto variable = localVariables.find(node->value);
+	if (!variable)
 		reportError(node, "Undefined Identifier");
-	expressionResult = localVariables.at(node->value);
+	setResult(node, variable->type);
 }
 
 void SemanticValidationPass::visit(UnaryExpression* node)
 {
-	std::vector<Type*> args;
-	AstVisitor::visit(node->expression.get());
-	args.push_back(expressionResult);
+	// the operand of a negated literal has the type expected for the whole expression
+	negatedLiteral = node->type == Token::Minus && node->expression->kind == AstKind::IntegerExpression;
+	dispatchExpected(node->expression, expectedType);
 
-	if (!unaryOperatorNames.contains(node->type))
-		reportError(node, "Unknown unary operator");
+	auto resolved = findOperator(node->type, expressionResult, nullptr);
+	if (!resolved)
+		reportError(node, unaryOperatorNames.contains(node->type) ? "No matching operator function found" : "Unknown unary operator");
 
-	if (!hasFunction(unaryOperatorNames.at(node->type), args))
-		reportError(node, "No matching operator function found");
-
-	expressionResult = getFunction(unaryOperatorNames.at(node->type), args).result;
+	node->intrinsic = resolved.intrinsic;
+	node->target = resolved.function;
+	setResult(node, resolved.getResult());
 }
 
 void SemanticValidationPass::visit(BinaryExpression* node)
 {
 	if (node->type == Token::Assign)
 	{
-		AstVisitor::visit(node->left.get());
+		if (node->left->kind != AstKind::IdentifierExpression && node->left->kind != AstKind::IndexExpression)
+			reportError(node->left, "Only variables and array elements can be assigned to");
+
+		dispatch(node->left);
 		auto left = expressionResult;
-		AstVisitor::visit(node->right.get());
+		dispatchExpected(node->right, left);
 		auto right = expressionResult;
 
-		if (!Type::areSame(left, right))
+		if (!areSame(node, left, right))
 			reportError(node, "Assignment type mismatch");
 
-		expressionResult = left;
+		setResult(node, left);
 	}
 	else
 	{
-		std::vector<Type*> args;
-		AstVisitor::visit(node->left.get());
-		args.push_back(expressionResult);
-		AstVisitor::visit(node->right.get());
-		args.push_back(expressionResult);
-
-		if (!binaryOperatorNames.contains(node->type))
-			reportError(node, "Unknown binary operator");
+		// a literal takes the type of the other operand, so that one is checked first.
+		// if both are literals, they take the type expected for the whole expression
+		auto expected = expectedType;
+		Type* left;
+		Type* right;
+		if (isUntypedConstant(node->left) && !isUntypedConstant(node->right))
+		{
+			dispatch(node->right);
+			right = expressionResult;
+			dispatchExpected(node->left, right);
+			left = expressionResult;
+		}
+		else
+		{
+			dispatchExpected(node->left, expected);
+			left = expressionResult;
+			dispatchExpected(node->right, left);
+			right = expressionResult;
+		}
 
-		if (!hasFunction(binaryOperatorNames.at(node->type), args))
-			reportError(node, "No matching operator function found");
+		auto resolved = findOperator(node->type, left, right);
+		if (!resolved)
+			reportError(node, binaryOperatorNames.contains(node->type) ? "No matching operator function found" : "Unknown binary operator");
 
-		expressionResult = getFunction(binaryOperatorNames.at(node->type), args).result;
+		node->intrinsic = resolved.intrinsic;
+		node->target = resolved.function;
+		setResult(node, resolved.getResult());
 	}
 }
 
@@ -90,73 +192,67 @@ void SemanticValidationPass::visit(CallExpression* node)
 	std::vector<Type*> args;
 	for (auto& arg : node->args)
 	{
-		AstVisitor::visit(arg.get());
+		dispatch(arg);
 		args.push_back(expressionResult);
 	}
 
-	std::string name = "";
-	if (dynamic_cast<IdentifierExpression*>(node->expression.get()))
+	Symbol name = {};
+	if (node->expression->kind == AstKind::IdentifierExpression)
 	{
-		name = dynamic_cast<IdentifierExpression*>(node->expression.get())->value;
-
-		node->functionIdentifier = name + "(";
-		for (size_t i = 0; i < args.size(); i++)
-		{
-			node->functionIdentifier += args[i]->toString();
-			if (i != args.size())
-				node->functionIdentifier += ",";
-		}
-		node->functionIdentifier += ")";
+		name = static_cast<IdentifierExpression*>(node->expression)->value;
 	}
 	else
 	{
 		// NOT IMPLEMENTED FULLY YET
-		throw std::exception("not implemented");
+		reportError(node, "Only functions can be called");
 
-		name = "__call__";
-		AstVisitor::visit(node->expression.get());
+		name = StringInterner::global().intern("__call__");
+		dispatch(node->expression);
 		args.insert(args.begin(), expressionResult);
 	}
 
-	if (!hasFunction(name, args))
+	auto function = findFunction(name, args);
+	if (!function)
 		reportError(node, "No matching function was found");
 
-	expressionResult = getFunction(name, args).result;
+	node->target = function;
+	setResult(node, function->result);
 }
 
 void SemanticValidationPass::visit(IndexExpression* node)
 {
-	AstVisitor::visit(node->expression.get());
+	dispatch(node->expression);
 	auto valueType = expressionResult;
 
-	if (dynamic_cast<ArrayType*>(valueType))
+	if (valueType->kind == TypeKind::Array)
 	{
 		if (node->args.size() != 1)
 			reportError(node, "Invalid parameter count for basic index expression");
 
-		AstVisitor::visit(node->args[0].get());
+		dispatch(node->args[0]);
 		auto indexType = expressionResult;
-		if (!Type::areSame(indexType, typeCtx.getNamedType("i64")))
+		if (!areSame(node->args[0], indexType, integerType))
 			reportError(node, "Invalid index type");
 
-		expressionResult = dynamic_cast<ArrayType*>(valueType)->base;
+		setResult(node, static_cast<ArrayType*>(valueType)->base);
 	}
-	else if (dynamic_cast<NamedType*>(valueType))
+	else if (valueType->kind == TypeKind::Named)
 	{
 		// NOT IMPLEMENTED FULLY YET
-		throw std::exception("not implemented");
+		reportError(node, "Index operator functions are not supported yet");
 
 		std::vector<Type*> args;
 		for (auto& arg : node->args)
 		{
-			AstVisitor::visit(arg.get());
+			dispatch(arg);
 			args.push_back(expressionResult);
 		}
 
-		if (!hasFunction("__index__", args))
+		auto function = findFunction(StringInterner::global().intern("__index__"), args);
+		if (!function)
 			reportError(node, "No matching index operator function found");
 
-		expressionResult = getFunction("__index__", args).result;
+		setResult(node, function->result);
 	}
 	else
 	{
@@ -166,146 +262,199 @@ void SemanticValidationPass::visit(IndexExpression* node)
 
 void SemanticValidationPass::visit(BlockStatement* node)
 {
-	for (auto& statement : node->statements)
-	{
-		AstVisitor::visit(statement.get());
-	}
+	localVariables.pushScope();
+	validateStatements(node->statements);
+	localVariables.popScope();
 }
 
 void SemanticValidationPass::visit(VariableStatement* node)
 {
 	for (size_t i = 0; i < node->names.size(); i++)
 	{
-		if (localVariables.contains(node->names[i]))
+		if (localVariables.isDeclaredInScope(node->names[i]))
 			reportError(node, "Variable is already defined");
-		AstVisitor::visit(node->values[i].get());
-		localVariables.try_emplace(node->names[i], expressionResult);
+		dispatch(node->values[i]);
+		if (!expressionResult->tryGetResolvedType())
+			reportError(node->values[i], "Expression has no value");
+		localVariables.declare(node->names[i], expressionResult);
 	}
 }
 
 void SemanticValidationPass::visit(ReturnStatement* node)
 {
-	AstVisitor::visit(node->expression.get());
-	if (!Type::areSame(expressionResult, functionResult))
-		reportError(node->expression.get(), "Return expression has to be of function result type");
+	if (functionResult == voidType)
+		reportError(node, "Function without result type can not return a value");
+
+	dispatchExpected(node->expression, functionResult);
+	if (!areSame(node->expression, expressionResult, functionResult))
+		reportError(node->expression, "Return expression has to be of function result type");
 }
 
 void SemanticValidationPass::visit(WhileStatement* node)
 {
-	AstVisitor::visit(node->condition.get());
-	if (!Type::areSame(expressionResult, typeCtx.getNamedType("bool")))
-		reportError(node->condition.get(), "While condition has to be of boolean type");
+	dispatch(node->condition);
+	if (!areSame(node->condition, expressionResult, boolType))
+		reportError(node->condition, "While condition has to be of boolean type");
 	
-	AstVisitor::visit(node->body.get());
+	dispatch(node->body);
 }
 
 void SemanticValidationPass::visit(IfStatement* node)
 {
-	AstVisitor::visit(node->condition.get());
-	if (!Type::areSame(expressionResult, typeCtx.getNamedType("bool")))
-		reportError(node->condition.get(), "If condition has to be of boolean type");
+	dispatch(node->condition);
+	if (!areSame(node->condition, expressionResult, boolType))
+		reportError(node->condition, "If condition has to be of boolean type");
 
-	AstVisitor::visit(node->ifBody.get());
-	if (node->elseBody) AstVisitor::visit(node->elseBody.get());
+	dispatch(node->ifBody);
+	if (node->elseBody) dispatch(node->elseBody);
 }
 
 void SemanticValidationPass::visit(FunctionDeclaration* node)
 {
-	// create vector if this is the first function called what it is called
-	if (!functions.contains(node->name))
-		functions.try_emplace(node->name, std::vector<FunctionDeclaration>());
-	
-	std::vector<Type*> args;
+	argumentIds.clear();
 	for (auto& param : node->parameters)
 	{
-		args.push_back(param.second);
+		auto type = param.second->tryGetResolvedType();
+		if (!type)
+			reportError(node, "Unknown parameter type");
+		argumentIds.push_back(type->id);
 	}
 
-	if (hasFunction(node->name, args))
-		reportError(node, "Function is already defined");
+	if (node->result != voidType && !node->result->tryGetResolvedType())
+		reportError(node, "Unknown result type");
 
 	// add function to known functions
-	functions.at(node->name).push_back(*node);
+	if (functions.add(node, argumentIds) == FunctionTable::NONE)
+		reportError(node, "Function is already defined");
 }
 
 void SemanticValidationPass::visit(Module* node)
 {
 	for (auto& declaration : node->declarations)
 	{
-		AstVisitor::visit(declaration.get());
+		try
+		{
+			dispatch(declaration);
+		}
+		catch (CompilationError&)
+		{
+			// already reported, continue with the next declaration
+		}
 	}
 }
 
-bool SemanticValidationPass::hasFunction(std::string const& name, std::vector<Type*> const& args)
+FunctionDeclaration* SemanticValidationPass::findFunction(Symbol name, std::vector<Type*> const& args)
 {
-	if (!functions.contains(name))
-		return false;
-
-	for (auto& candidate : functions.at(name))
+	argumentIds.clear();
+	for (auto arg : args)
 	{
-		// parameter count differs, no match found
-		if (candidate.parameters.size() != args.size())
-			continue;
-
-		for (size_t i = 0; i < candidate.parameters.size(); i++)
-		{
-			// parameter is different, no match found
-			if (!Type::areSame(candidate.parameters[i].second, args[i]))
-				break;
-
-			if (i == candidate.parameters.size() - 1)
-			{
-				return true;
-			}
-		}
+		// an argument of unknown type matches no overload
+		auto type = arg->tryGetResolvedType();
+		if (!type)
+			return nullptr;
+		argumentIds.push_back(type->id);
 	}
 
-	return false;
+	auto id = functions.find(name, argumentIds);
+	return (id != FunctionTable::NONE) ? functions.get(id) : nullptr;
 }
 
-FunctionDeclaration const& SemanticValidationPass::getFunction(std::string const& name, std::vector<Type*> const& args)
+SemanticValidationPass::ResolvedOperator SemanticValidationPass::findOperator(Token op, Type* left, Type* right)
 {
-	if (!functions.contains(name))
-		throw std::exception();
+	auto leftType = left->tryGetResolvedType();
+	auto rightType = right ? right->tryGetResolvedType() : nullptr;
+	if (!leftType || (right && !rightType))
+		return {};
 
-	for (auto& candidate : functions.at(name))
+	// a table lookup, the overloads are never searched for builtin operands
+	if (leftType->kind == TypeKind::Builtin && (!rightType || rightType->kind == TypeKind::Builtin))
 	{
-		// parameter count differs, no match found
-		if (candidate.parameters.size() != args.size())
-			continue;
+		operatorCache.countIntrinsicLookup();
+		return { typeCtx.findIntrinsic(op, leftType, rightType), nullptr };
+	}
 
-		for (size_t i = 0; i < candidate.parameters.size(); i++)
-		{
-			// parameter is different, no match found
-			if (!Type::areSame(candidate.parameters[i].second, args[i]))
-				break;
+	OperatorKey key = { op, leftType->id, rightType ? rightType->id : OperatorKey::NONE };
+	return { nullptr, operatorCache.get(key, [&]() -> FunctionDeclaration* {
+		auto& names = right ? binaryOperatorNames : unaryOperatorNames;
+		auto name = names.find(op);
+		if (name == names.end())
+			return nullptr;
 
-			if (i == candidate.parameters.size() - 1)
-			{
-				return candidate;
-			}
-		}
-	}
+		argumentIds.assign({ leftType->id });
+		if (rightType)
+			argumentIds.push_back(rightType->id);
 
-	throw std::exception("No matching function");
+		auto id = functions.find(name->second, argumentIds);
+		return (id != FunctionTable::NONE) ? functions.get(id) : nullptr;
+	}) };
 }
 
-void SemanticValidationPass::reportError(AstNode* node, std::string msg)
+void SemanticValidationPass::dispatchExpected(Expression* node, Type* expected)
+{
+	// only literals and arithmetic on them see the expected type, the operands of other expressions do not
+	expectedType = isUntypedConstant(node) ? expected : nullptr;
+	dispatch(node);
+	expectedType = nullptr;
+}
+
+bool SemanticValidationPass::isUntypedConstant(Expression* node)
 {
-	size_t line = 1, column = 1;
-	for (size_t i = 0; i < node->begin && i < source.length(); i++) 
+	switch (node->kind)
 	{
-		if (source[i] == '\n') 
-		{
-			line++;
-			column = 1;
-		} 
-		else 
+	case AstKind::IntegerExpression:
+		return !static_cast<IntegerExpression*>(node)->suffixType;
+	case AstKind::UnaryExpression:
+		return isUntypedConstant(static_cast<UnaryExpression*>(node)->expression);
+	case AstKind::BinaryExpression:
+	{
+		// comparisons and logical operators do not result in the type of their operands
+		auto binary = static_cast<BinaryExpression*>(node);
+		switch (binary->type)
 		{
-			column++;
+		case Token::Plus: case Token::Minus: case Token::Multiply: case Token::Divide: case Token::Modulo:
+		case Token::BitwiseAnd: case Token::BitwiseOr: case Token::BitwiseXor: case Token::ShiftLeft: case Token::ShiftRight:
+			return isUntypedConstant(binary->left) && isUntypedConstant(binary->right);
+		default:
+			return false;
 		}
 	}
+	default:
+		return false;
+	}
+}
 
-	logStream << "ln " << line << ", col " << column << ", \"" << source.substr(node->begin, node->end - node->begin) << "\": " << msg << "\n";
-	throw std::exception(msg.c_str());
+bool SemanticValidationPass::literalFits(uint64_t value, Type* type, bool negated)
+{
+	// the builtin types with arithmetic intrinsics are the integer types
+	auto resolved = type->tryGetResolvedType();
+	if (!resolved || !typeCtx.findIntrinsic(Token::Plus, resolved, resolved))
+		return false;
+
+	// a negated literal may be one past the maximum of a signed type, that is its minimum
+	auto builtin = static_cast<BuiltinType*>(resolved);
+	if (builtin->isSigned && negated)
+		return value <= (uint64_t)1 << (builtin->bitSize - 1);
+	auto bits = builtin->isSigned ? builtin->bitSize - 1 : builtin->bitSize;
+	return bits >= 64 || value >> bits == 0;
+}
+
+void SemanticValidationPass::setResult(Expression* node, Type* type)
+{
+	expressionResult = type;
+	node->resolvedType = type->tryGetResolvedType();
+}
+
+bool SemanticValidationPass::areSame(AstNode* node, Type* a, Type* b)
+{
+	auto resolvedA = a->tryGetResolvedType();
+	auto resolvedB = b->tryGetResolvedType();
+	if (!resolvedA || !resolvedB)
+		reportError(node, "Expression has no value");
+	return resolvedA->id == resolvedB->id;
+}
+
+void SemanticValidationPass::reportError(AstNode* node, std::string msg)
+{
+	diagnostics.error(node->begin, node->end, msg);
+	throw CompilationError(msg);
 }
\ No newline at end of file
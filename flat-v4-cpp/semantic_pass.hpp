@@ -1,28 +1,55 @@
 #pragma once
 #include "ast.hpp"
+#include "diagnostics.hpp"
+#include "function_table.hpp"
+#include "operator_cache.hpp"
+#include "thread_pool.hpp"
+#include "scope_stack.hpp"
 #include <iostream>
 
-class SemanticValidationPass : AstVisitor
+// the function table is filled by extractFunctions and only read while the bodies are validated,
+// so the bodies can be validated in parallel by passes that share it
+class SemanticValidationPass : public StaticAstVisitor<SemanticValidationPass>
 {
 public:
 	TypeContext& typeCtx;
-	std::string_view source;
-	std::ostream& logStream;
+	DiagnosticEngine& diagnostics;
 
-	std::unordered_map<std::string, std::vector<FunctionDeclaration>> functions;
+	FunctionTable& functions;
+	OperatorCache operatorCache;
 
 	Type* expressionResult;
 	Type* functionResult;
 
-	std::unordered_map<std::string, Type*> localVariables;
+	// type an integer literal without suffix should have, null if the context expects none
+	Type* expectedType;
+
+	// set while the literal that is the operand of a unary minus is checked, it may then be the signed minimum
+	bool negatedLiteral;
+
+	Type* integerType;
+	Type* boolType;
+
+	// result type of functions declared without one, it resolves to no type
+	Type* voidType;
+
+	ScopeStack localVariables;
+
+	// reused for the lookups in the function table
+	std::vector<TypeId> argumentIds;
 
 public:
-	SemanticValidationPass(TypeContext& typeCtx, std::string_view source, std::ostream& logStream) :
+	SemanticValidationPass(TypeContext& typeCtx, DiagnosticEngine& diagnostics, FunctionTable& functions) :
 		typeCtx(typeCtx),
-		source(source),
-		logStream(logStream),
+		diagnostics(diagnostics),
+		functions(functions),
 		expressionResult(nullptr),
-		functionResult(nullptr)
+		functionResult(nullptr),
+		expectedType(nullptr),
+		negatedLiteral(false),
+		integerType(typeCtx.getNamedType("i64")),
+		boolType(typeCtx.getNamedType("bool")),
+		voidType(typeCtx.getNamedType("void"))
 	{
 	}
 
@@ -30,61 +57,93 @@ public:
 	void extractFunctions(Module* node);
 	void validateFunctions();
 
+	// validates batches of functions on the pool, each with its own pass and diagnostics. the
+	// diagnostics are appended in function order, so they come out like they do from validateFunctions()
+	void validateFunctions(ThreadPool& pool);
+
+private:
+	void validateFunction(FunctionDeclaration* function);
+	void validateStatements(std::span<Statement*> statements);
+
 public:
-	void visit(IntegerExpression* node) override;
-	void visit(IdentifierExpression* node) override;
-	void visit(UnaryExpression* node) override;
-	void visit(BinaryExpression* node) override;
-	void visit(CallExpression* node) override;
-	void visit(IndexExpression* node) override;
-
-	void visit(BlockStatement* node) override;
-	void visit(VariableStatement* node) override;
-	void visit(ReturnStatement* node) override;
-	void visit(WhileStatement* node) override;
-	void visit(IfStatement* node) override;
-
-	void visit(FunctionDeclaration* node) override;
-	void visit(Module* node) override;
+	void visit(IntegerExpression* node);
+	void visit(IdentifierExpression* node);
+	void visit(UnaryExpression* node);
+	void visit(BinaryExpression* node);
+	void visit(CallExpression* node);
+	void visit(IndexExpression* node);
+
+	void visit(BlockStatement* node);
+	void visit(VariableStatement* node);
+	void visit(ReturnStatement* node);
+	void visit(WhileStatement* node);
+	void visit(IfStatement* node);
+
+	void visit(FunctionDeclaration* node);
+	void visit(Module* node);
 
 public:
-	bool hasFunction(std::string const& name, std::vector<Type*> const& args);
-	FunctionDeclaration const& getFunction(std::string const& name, std::vector<Type*> const& args);
+	// returns null if there is no overload for the argument types
+	FunctionDeclaration* findFunction(Symbol name, std::vector<Type*> const& args);
+
+	// an intrinsic if the operands are builtin types, otherwise the operator function of the user defined type
+	struct ResolvedOperator
+	{
+		Intrinsic const* intrinsic;
+		FunctionDeclaration* function;
+
+		explicit operator bool() const { return intrinsic || function; }
+		Type* getResult() const { return intrinsic ? intrinsic->result : function->result; }
+	};
+
+	// right is null for unary operators. builtin operands only resolve to intrinsics, operator functions
+	// are only looked up if an operand has a user defined type. returns an empty result if nothing matches
+	ResolvedOperator findOperator(Token op, Type* left, Type* right);
 
 public:
+	// dispatches node with expectedType set if it is a literal without suffix or arithmetic on such literals
+	void dispatchExpected(Expression* node, Type* expected);
+	bool isUntypedConstant(Expression* node);
+	bool literalFits(uint64_t value, Type* type, bool negated = false);
+
+	// like Type::areSame, but a type that does not resolve, like the result of a void call, is reported at node
+	bool areSame(AstNode* node, Type* a, Type* b);
+
+	// sets expressionResult and stores the resolved type on the node for the passes after this one
+	void setResult(Expression* node, Type* type);
 	void reportError(AstNode* node, std::string msg);
 
 public:
-	static const inline std::unordered_map<Token, std::string> unaryOperatorNames =
+	static const inline std::unordered_map<Token, Symbol> unaryOperatorNames =
 	{
-		{ Token::Plus, "__positive__" },
-		{ Token::Minus, "__negative__" },
-		{ Token::LogicalNot, "__not__" },
-		{ Token::BitwiseNot, "__bitnot__" },
+		{ Token::Plus, StringInterner::global().intern("__positive__") },
+		{ Token::Minus, StringInterner::global().intern("__negative__") },
+		{ Token::LogicalNot, StringInterner::global().intern("__not__") },
+		{ Token::BitwiseNot, StringInterner::global().intern("__bitnot__") },
 	};
 
-	static const inline std::unordered_map<Token, std::string> binaryOperatorNames =
+	static const inline std::unordered_map<Token, Symbol> binaryOperatorNames =
 	{
-		{ Token::Plus, "__add__" },
-		{ Token::Minus, "__subtract__" },
-		{ Token::Multiply, "__multiply__" },
-		{ Token::Divide, "__divide__" },
-		{ Token::Modulo, "__modulo__" },
-
-		{ Token::BitwiseAnd, "__bitand__" },
-		{ Token::BitwiseNot, "__bitor__" },
-		{ Token::BitwiseXor, "__bitxor__" },
-		{ Token::ShiftLeft, "__lshift__" },
-		{ Token::ShiftRight, "__rshift__" },
-
-		{ Token::LogicalAnd, "__and__" },
-		{ Token::LogicalOr, "__or__" },
-
-		{ Token::Equal, "__equal__" },
-		{ Token::NotEqual, "__notequal__" },
-		{ Token::LessThan, "__less__" },
-		{ Token::GreaterThan, "__greater__" },
-		{ Token::LessOrEqual, "__lessorequal__" },
-		{ Token::GreaterOrEqual, "__greaterorequal__" },
+		{ Token::Plus, StringInterner::global().intern("__add__") },
+		{ Token::Minus, StringInterner::global().intern("__subtract__") },
+		{ Token::Multiply, StringInterner::global().intern("__multiply__") },
+		{ Token::Divide, StringInterner::global().intern("__divide__") },
+		{ Token::Modulo, StringInterner::global().intern("__modulo__") },
+
+		{ Token::BitwiseAnd, StringInterner::global().intern("__bitand__") },
+		{ Token::BitwiseOr, StringInterner::global().intern("__bitor__") },
+		{ Token::BitwiseXor, StringInterner::global().intern("__bitxor__") },
+		{ Token::ShiftLeft, StringInterner::global().intern("__lshift__") },
+		{ Token::ShiftRight, StringInterner::global().intern("__rshift__") },
+
+		{ Token::LogicalAnd, StringInterner::global().intern("__and__") },
+		{ Token::LogicalOr, StringInterner::global().intern("__or__") },
+
+		{ Token::Equal, StringInterner::global().intern("__equal__") },
+		{ Token::NotEqual, StringInterner::global().intern("__notequal__") },
+		{ Token::LessThan, StringInterner::global().intern("__less__") },
+		{ Token::GreaterThan, StringInterner::global().intern("__greater__") },
+		{ Token::LessOrEqual, StringInterner::global().intern("__lessorequal__") },
+		{ Token::GreaterOrEqual, StringInterner::global().intern("__greaterorequal__") },
 	};
 };
\ No newline at end of file
@@ -0,0 +1,26 @@
+#include "source_file.hpp"
+#include <algorithm>
+#include <cstring>
+
+SourceFile::SourceFile(std::string_view text) :
+	text(text)
+{
+	lineStarts.push_back(0);
+	for (auto it = text.data(), end = text.data() + text.length(); it < end; it++)
+	{
+		it = (char const*)memchr(it, '\n', end - it);
+		if (!it)
+			break;
+		lineStarts.push_back(it - text.data() + 1);
+	}
+}
+
+SourceLocation SourceFile::getLocation(size_t position) const
+{
+	position = std::min(position, text.length());
+
+	// first line starting after position, the line before it contains position
+	auto it = std::upper_bound(lineStarts.begin(), lineStarts.end(), position);
+	size_t line = it - lineStarts.begin();
+	return { line, position - lineStarts[line - 1] + 1 };
+}
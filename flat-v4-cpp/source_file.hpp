@@ -0,0 +1,21 @@
+#pragma once
+#include <string_view>
+#include <vector>
+
+struct SourceLocation
+{
+	size_t line, column;
+};
+
+class SourceFile
+{
+public:
+	std::string_view text;
+	std::vector<size_t> lineStarts;
+
+public:
+	SourceFile(std::string_view text);
+
+public:
+	SourceLocation getLocation(size_t position) const;
+};
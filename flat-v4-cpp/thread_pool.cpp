@@ -0,0 +1,69 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threadCount) :
+	activeTasks(0),
+	stopping(false)
+{
+	for (size_t i = 0; i < std::max<size_t>(threadCount, 1); i++)
+		workers.emplace_back([this] { work(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	taskAvailable.notify_all();
+
+	for (auto& worker : workers)
+		worker.join();
+}
+
+size_t ThreadPool::getDefaultThreadCount()
+{
+	return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+	{
+		std::lock_guard lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+	taskAvailable.notify_one();
+}
+
+void ThreadPool::wait()
+{
+	std::unique_lock lock(mutex);
+	tasksDone.wait(lock, [this] { return tasks.empty() && activeTasks == 0; });
+}
+
+void ThreadPool::work()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock lock(mutex);
+			taskAvailable.wait(lock, [this] { return stopping || !tasks.empty(); });
+			if (tasks.empty())
+				return;
+
+			task = std::move(tasks.front());
+			tasks.pop_front();
+			activeTasks++;
+		}
+
+		task();
+
+		{
+			std::lock_guard lock(mutex);
+			activeTasks--;
+			if (tasks.empty() && activeTasks == 0)
+				tasksDone.notify_all();
+		}
+	}
+}
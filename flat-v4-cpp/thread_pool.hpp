@@ -0,0 +1,41 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads running tasks from a shared queue
+class ThreadPool
+{
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+
+	std::mutex mutex;
+	std::condition_variable taskAvailable;
+	std::condition_variable tasksDone;
+	size_t activeTasks;
+	bool stopping;
+
+public:
+	ThreadPool(size_t threadCount);
+	~ThreadPool();
+
+	ThreadPool(ThreadPool const&) = delete;
+	ThreadPool& operator=(ThreadPool const&) = delete;
+
+public:
+	static size_t getDefaultThreadCount();
+
+	void submit(std::function<void()> task);
+
+	// blocks until the queue is empty and no task is running
+	void wait();
+
+	inline size_t size() const { return workers.size(); }
+
+private:
+	void work();
+};
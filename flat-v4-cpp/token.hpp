@@ -1,6 +1,7 @@
 #pragma once
+#include <cstdint>
 
-enum class Token
+enum class Token : uint8_t
 {
 	Eof,
 	Error,
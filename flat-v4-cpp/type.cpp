@@ -1,101 +1,258 @@
 #include "type.hpp"
+#include <algorithm>
+#include <bit>
 
 bool Type::areSame(Type* a, Type* b)
 {
-	return a->getResolvedType()->isSame(b->getResolvedType());
+	return a->getResolvedId() == b->getResolvedId();
 }
 
-Type* TypeContext::getNamedType(std::string const& name)
+Type* Type::getResolvedType()
 {
+	auto type = tryGetResolvedType();
+	if (!type)
+		throw std::exception("Unknown type");
+	return type;
+}
+
+Type* Type::tryGetResolvedType()
+{
+	auto type = resolved.load(std::memory_order_acquire);
+	if (!type)
+	{
+		// resolving is idempotent, so concurrent resolutions store the same type
+		type = resolve();
+		resolved.store(type, std::memory_order_release);
+	}
+	return type;
+}
+
+Type* TypeContext::addBuiltinType(std::string_view name, size_t bitSize, bool isSigned)
+{
+	auto symbol = StringInterner::global().intern(name);
+	std::lock_guard lock(mutex);
+	if (!builtinTypes.contains(symbol))
+		builtinTypes.try_emplace(symbol, make<BuiltinType>(*this, symbol, bitSize, isSigned, builtinTypes.size()));
+	return builtinTypes.at(symbol);
+}
+
+// the types every program can use
+void TypeContext::addBuiltinTypes()
+{
+	addBuiltinType("u8", 8);
+	addBuiltinType("u16", 16);
+	addBuiltinType("u32", 32);
+	addBuiltinType("u64", 64);
+	addBuiltinType("i8", 8, true);
+	addBuiltinType("i16", 16, true);
+	addBuiltinType("i32", 32, true);
+	addBuiltinType("i64", 64, true);
+	addBuiltinType("bool", 1);
+	addBuiltinType("char", 8);
+	addBuiltinType("pointer", 64);
+	addIntrinsics();
+}
+
+// the operators of the builtin types. there are no implicit conversions, so both operands have the same type
+void TypeContext::addIntrinsics()
+{
+	intrinsicTypeCount = builtinTypes.size();
+	intrinsics.clear();
+	intrinsicTable.assign(std::size(tokenNames) * intrinsicTypeCount * (intrinsicTypeCount + 1), 0);
+
+	auto boolType = builtinTypes.at(StringInterner::global().intern("bool"));
+	for (auto name : { "u8", "u16", "u32", "u64", "i8", "i16", "i32", "i64", "char" })
+	{
+		auto type = builtinTypes.at(StringInterner::global().intern(name));
+		for (auto op : { Token::Plus, Token::Minus, Token::BitwiseNot })
+			addIntrinsic(op, type, nullptr, type);
+		for (auto op : { Token::Plus, Token::Minus, Token::Multiply, Token::Divide, Token::Modulo,
+			Token::BitwiseAnd, Token::BitwiseOr, Token::BitwiseXor, Token::ShiftLeft, Token::ShiftRight })
+			addIntrinsic(op, type, type, type);
+		for (auto op : { Token::Equal, Token::NotEqual, Token::LessThan, Token::GreaterThan, Token::LessOrEqual, Token::GreaterOrEqual })
+			addIntrinsic(op, type, type, boolType);
+	}
+
+	addIntrinsic(Token::LogicalNot, boolType, nullptr, boolType);
+	for (auto op : { Token::LogicalAnd, Token::LogicalOr, Token::Equal, Token::NotEqual })
+		addIntrinsic(op, boolType, boolType, boolType);
+
+	auto pointerType = builtinTypes.at(StringInterner::global().intern("pointer"));
+	for (auto op : { Token::Equal, Token::NotEqual })
+		addIntrinsic(op, pointerType, pointerType, boolType);
+}
+
+void TypeContext::addIntrinsic(Token op, Type* left, Type* right, Type* result)
+{
+	intrinsics.push_back({ op, left, right, result });
+	auto index = getIntrinsicIndex(op, static_cast<BuiltinType*>(left), static_cast<BuiltinType*>(right));
+	intrinsicTable[index] = (uint16_t)intrinsics.size();
+}
+
+size_t TypeContext::getIntrinsicIndex(Token op, BuiltinType* left, BuiltinType* right)
+{
+	// unary operators use the column after the last builtin type
+	auto rightIndex = right ? right->index : intrinsicTypeCount;
+	return ((size_t)op * intrinsicTypeCount + left->index) * (intrinsicTypeCount + 1) + rightIndex;
+}
+
+Intrinsic const* TypeContext::findIntrinsic(Token op, Type* left, Type* right)
+{
+	if (left->kind != TypeKind::Builtin || (right && right->kind != TypeKind::Builtin))
+		return nullptr;
+
+	// builtin types added after the intrinsics have none
+	auto leftBuiltin = static_cast<BuiltinType*>(left);
+	auto rightBuiltin = static_cast<BuiltinType*>(right);
+	if (leftBuiltin->index >= intrinsicTypeCount || (right && rightBuiltin->index >= intrinsicTypeCount))
+		return nullptr;
+
+	auto entry = intrinsicTable[getIntrinsicIndex(op, leftBuiltin, rightBuiltin)];
+	return entry ? &intrinsics[entry - 1] : nullptr;
+}
+
+Type* TypeContext::addStructType(std::string_view name, std::vector<std::pair<Symbol, Type*>> members, bool packed)
+{
+	auto symbol = StringInterner::global().intern(name);
+	std::lock_guard lock(mutex);
+	if (!structTypes.contains(symbol))
+		structTypes.try_emplace(symbol, make<StructType>(*this, symbol, std::move(members), packed));
+	return structTypes.at(symbol);
+}
+
+Type* TypeContext::getNamedType(Symbol name)
+{
+	std::lock_guard lock(mutex);
 	if (!namedTypes.contains(name))
-		namedTypes.try_emplace(name, new NamedType(*this, name));
+		namedTypes.try_emplace(name, make<NamedType>(*this, name));
 	return namedTypes.at(name);
 }
 
+Type* TypeContext::getNamedType(std::string_view name)
+{
+	return getNamedType(StringInterner::global().intern(name));
+}
+
 Type* TypeContext::getPointerType(Type* base)
 {
+	std::lock_guard lock(mutex);
 	if (!pointerTypes.contains(base))
-		pointerTypes.try_emplace(base, new PointerType(base));
+		pointerTypes.try_emplace(base, make<PointerType>(base));
 	return pointerTypes.at(base);
 }
 
 Type* TypeContext::getArrayType(Type* base)
 {
+	std::lock_guard lock(mutex);
 	if (!arrayTypes.contains(base))
-		arrayTypes.try_emplace(base, new ArrayType(base));
+		arrayTypes.try_emplace(base, make<ArrayType>(base));
 	return arrayTypes.at(base);
 }
 
-Type* TypeContext::resolveNamedType(std::string const& name)
+Type* TypeContext::resolveNamedType(Symbol name)
+{
+	auto type = findNamedType(name);
+	if (!type)
+		throw std::exception("Unknown type");
+	return type;
+}
+
+Type* TypeContext::findNamedType(Symbol name)
 {
+	std::lock_guard lock(mutex);
 	if (builtinTypes.contains(name))
 		return builtinTypes.at(name);
 	else if (structTypes.contains(name))
 		return structTypes.at(name);
-
-	throw std::exception("Unknown type");
+	return nullptr;
 }
 
-size_t BuiltinType::getBitSize()
+void TypeContext::resolveTypes()
 {
-	return bitSize;
+	// resolving a pointer or array type may add the one of the resolved base, which is resolved in turn
+	for (size_t i = 0; i < types.size(); i++)
+		types[i]->tryGetResolvedType();
 }
 
-bool BuiltinType::isSame(Type* other)
+Layout const& TypeContext::getLayout(Type* type)
 {
-	return dynamic_cast<BuiltinType*>(other) 
-		&& name == dynamic_cast<BuiltinType*>(other)->name 
-		&& bitSize == dynamic_cast<BuiltinType*>(other)->bitSize;
-}
+	auto resolved = type->getResolvedType();
+	{
+		std::lock_guard lock(mutex);
+		auto it = layouts.find(resolved->id);
+		if (it != layouts.end())
+			return it->second;
+	}
 
-Type* BuiltinType::getResolvedType()
-{
-	return this;
+	// computed outside of the lock, the layouts of the members are looked up in turn
+	auto layout = computeLayout(resolved);
+	std::lock_guard lock(mutex);
+	return layouts.try_emplace(resolved->id, std::move(layout)).first->second;
 }
 
-std::string BuiltinType::toString()
+Layout TypeContext::computeLayout(Type* type)
 {
-	return name;
-}
+	auto pointerBytes = pointerSize / 8;
+	switch (type->kind)
+	{
+	case TypeKind::Builtin:
+	{
+		auto size = std::max<size_t>((static_cast<BuiltinType*>(type)->bitSize + 7) / 8, 1);
+		return { size, std::min(std::bit_ceil(size), pointerBytes), {} };
+	}
+	case TypeKind::Pointer:
+	case TypeKind::Array:
+		return { pointerBytes, pointerBytes, {} };
 
-size_t StructType::getBitSize()
-{
-	size_t bitSize = 0;
-	for (auto& [name, type] : members)
+	case TypeKind::Struct:
 	{
-		bitSize += type->getBitSize();
-		bitSize = (size_t)(ceil(bitSize / (double)ctx.pointerSize) * ctx.pointerSize); // align bitSize to pointer size
+		auto structType = static_cast<StructType*>(type);
+		Layout layout = { 0, 1, {} };
+		for (auto& [name, memberType] : structType->members)
+		{
+			auto& member = getLayout(memberType);
+			auto alignment = structType->packed ? 1 : member.alignment;
+			layout.size = (layout.size + alignment - 1) / alignment * alignment;
+			layout.offsets.push_back(layout.size);
+			layout.size += member.size;
+			layout.alignment = std::max(layout.alignment, alignment);
+		}
+		layout.size = (layout.size + layout.alignment - 1) / layout.alignment * layout.alignment;
+		return layout;
 	}
+	default:
+		throw std::exception("Unknown type");
+	}
+}
 
+size_t BuiltinType::getBitSize()
+{
 	return bitSize;
 }
 
-bool StructType::isSame(Type* other)
+Type* BuiltinType::resolve()
 {
-	auto o = dynamic_cast<StructType const*>(other);
-	if (!o)
-		return false;
-
-	if (members.size() != o->members.size())
-		return false;
+	return this;
+}
 
-	for (size_t i = 0; i < members.size(); i++)
-	{
-		if (!Type::areSame(members[i].second, o->members[i].second))
-			return false;
-	}
+std::string BuiltinType::toString()
+{
+	return StringInterner::global().str(name);
+}
 
-	return true;
+size_t StructType::getBitSize()
+{
+	return ctx.getLayout(this).size * 8;
 }
 
-Type* StructType::getResolvedType()
+Type* StructType::resolve()
 {
 	return this;
 }
 
 std::string StructType::toString()
 {
-	return name;
+	return StringInterner::global().str(name);
 }
 
 size_t PointerType::getBitSize()
@@ -103,15 +260,12 @@ size_t PointerType::getBitSize()
 	return ctx.pointerSize;
 }
 
-bool PointerType::isSame(Type* other)
-{
-	return dynamic_cast<PointerType const*>(other) 
-		&& Type::areSame(base, dynamic_cast<PointerType const*>(other)->base);
-}
-
-Type* PointerType::getResolvedType()
+Type* PointerType::resolve()
 {
-	return this;
+	auto resolvedBase = base->tryGetResolvedType();
+	if (!resolvedBase)
+		return nullptr;
+	return (resolvedBase == base) ? this : ctx.getPointerType(resolvedBase)->tryGetResolvedType();
 }
 
 std::string PointerType::toString()
@@ -124,15 +278,12 @@ size_t ArrayType::getBitSize()
 	return ctx.pointerSize;
 }
 
-bool ArrayType::isSame(Type* other)
-{
-	return dynamic_cast<ArrayType const*>(other) 
-		&& Type::areSame(base, dynamic_cast<ArrayType const*>(other)->base);
-}
-
-Type* ArrayType::getResolvedType()
+Type* ArrayType::resolve()
 {
-	return this;
+	auto resolvedBase = base->tryGetResolvedType();
+	if (!resolvedBase)
+		return nullptr;
+	return (resolvedBase == base) ? this : ctx.getArrayType(resolvedBase)->tryGetResolvedType();
 }
 
 std::string ArrayType::toString()
@@ -145,17 +296,13 @@ size_t NamedType::getBitSize()
 	return getResolvedType()->getBitSize();
 }
 
-bool NamedType::isSame(Type* other)
-{
-	return Type::areSame(getResolvedType(), other);
-}
-
-Type* NamedType::getResolvedType()
+Type* NamedType::resolve()
 {
-	return ctx.resolveNamedType(name);
+	auto type = ctx.findNamedType(name);
+	return type ? type->tryGetResolvedType() : nullptr;
 }
 
 std::string NamedType::toString()
 {
-	return name;
+	return StringInterner::global().str(name);
 }
\ No newline at end of file
@@ -1,96 +1,227 @@
 #pragma once
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <atomic>
 #include <map>
+#include <mutex>
+#include <vector>
 #include <unordered_map>
 
+#include "interner.hpp"
+#include "pool_allocator.hpp"
+#include "token.hpp"
+
 class TypeContext;
+class BuiltinType;
+
+// dense index of a type in its TypeContext, equal ids of resolved types mean the same type
+enum class TypeId : uint32_t {};
+
+// concrete type class, lets passes dispatch with a switch instead of dynamic_cast
+enum class TypeKind : uint8_t
+{
+	Builtin,
+	Struct,
+	Pointer,
+	Array,
+	Named,
+};
 
 class Type
 {
+	friend class TypeContext;
+
 public:
+	TypeKind kind;
 	TypeContext& ctx;
+	TypeId id;
+
+private:
+	// the unique type this one stands for, named types resolve to the type they name
+	// and pointer and array types to the ones of their resolved base. null until resolved,
+	// atomic because the passes that run in parallel resolve types that are used before they are declared
+	std::atomic<Type*> resolved;
 
 public:
-	Type(TypeContext& ctx) :
-		ctx(ctx)
+	Type(TypeKind kind, TypeContext& ctx) :
+		kind(kind),
+		ctx(ctx),
+		id(),
+		resolved(nullptr)
 	{
 	}
 
+	virtual ~Type() = default;
+
 public:
 	virtual size_t getBitSize() = 0;
-	virtual bool isSame(Type* other) = 0;
-	virtual Type* getResolvedType() = 0;
 	virtual std::string toString() = 0;
 
+	// throws if the type names a type that does not exist
+	Type* getResolvedType();
+	Type* tryGetResolvedType();
+	TypeId getResolvedId() { return getResolvedType()->id; }
+	bool isSame(Type* other) { return areSame(this, other); }
+
+protected:
+	// returns the unique type for this one or null if it names a type that does not exist
+	virtual Type* resolve() = 0;
+
 public:
 	static bool areSame(Type* a, Type* b);
 };
 
+// memory layout of a type in bytes
+struct Layout
+{
+	size_t size, alignment;
+
+	// offsets of the members of a struct, empty for other types
+	std::vector<size_t> offsets;
+};
+
+// operator on builtin operands that is emitted inline instead of calling an operator function, right is null for unary operators
+struct Intrinsic
+{
+	Token op;
+	Type* left;
+	Type* right;
+	Type* result;
+};
+
+// owns all types, every type is created once and lives as long as the context
 class TypeContext
 {
 public:
 	size_t pointerSize;
 
-	std::unordered_map<std::string, Type*> namedTypes;
-	std::unordered_map<std::string, Type*> builtinTypes;
-	std::unordered_map<std::string, Type*> structTypes;
+	std::unordered_map<Symbol, Type*> namedTypes;
+	std::unordered_map<Symbol, Type*> builtinTypes;
+	std::unordered_map<Symbol, Type*> structTypes;
 	std::unordered_map<Type*, Type*> pointerTypes;
 	std::unordered_map<Type*, Type*> arrayTypes;
 
+	// indexed by TypeId
+	std::vector<Type*> types;
+	PoolAllocator allocator;
+
+	// keyed by the id of the resolved type
+	std::unordered_map<TypeId, Layout> layouts;
+
+	// registered with the builtin types and read only afterwards, so the passes look them up without locking.
+	// the table holds the index + 1 of the intrinsic for an operator and the indices of the builtin operand types, 0 if there is none
+	std::vector<Intrinsic> intrinsics;
+	std::vector<uint16_t> intrinsicTable;
+	size_t intrinsicTypeCount;
+
+	// guards the type tables, declarations are parsed in parallel
+	std::mutex mutex;
+
 public:
 	TypeContext(size_t pointerSize) :
-		pointerSize(pointerSize)
+		pointerSize(pointerSize),
+		intrinsicTypeCount(0)
 	{
 	}
 
+	TypeContext(TypeContext const&) = delete;
+	TypeContext& operator=(TypeContext const&) = delete;
+
 public:
-	Type* getNamedType(std::string const& name);
+	Type* addBuiltinType(std::string_view name, size_t bitSize, bool isSigned = false);
+	void addBuiltinTypes();
+	Type* addStructType(std::string_view name, std::vector<std::pair<Symbol, Type*>> members, bool packed = false);
+
+	Type* getNamedType(Symbol name);
+	Type* getNamedType(std::string_view name);
 	Type* getPointerType(Type* base);
 	Type* getArrayType(Type* base);
-	Type* resolveNamedType(std::string const& name);
+	Type* resolveNamedType(Symbol name);
+	Type* findNamedType(Symbol name);
+
+	// resolves every type once all declarations are known, so the passes only compare ids.
+	// types that name an unknown type are left unresolved and report the error when they are used
+	void resolveTypes();
+
+	inline Type* getType(TypeId id) { return types[(size_t)id]; }
+
+	// computed once per type. members are aligned to their natural alignment like in C, unless the struct is packed
+	Layout const& getLayout(Type* type);
+
+	// left and right have to be resolved, right is null for unary operators. returns null if an operand
+	// is no builtin type or the operator can not be applied to the builtin types
+	Intrinsic const* findIntrinsic(Token op, Type* left, Type* right);
+
+private:
+	Layout computeLayout(Type* type);
+
+	void addIntrinsics();
+	void addIntrinsic(Token op, Type* left, Type* right, Type* result);
+	size_t getIntrinsicIndex(Token op, BuiltinType* left, BuiltinType* right);
+
+	template<typename T, typename... Args>
+	T* make(Args&&... args)
+	{
+		auto type = allocator.make<T>(std::forward<Args>(args)...);
+		type->id = (TypeId)types.size();
+		types.push_back(type);
+		return type;
+	}
 };
 
 class BuiltinType : public Type
 {
 public:
-	std::string name;
+	Symbol name;
 	size_t bitSize;
+	bool isSigned;
+
+	// position among the builtin types, indexes the intrinsic table
+	size_t index;
 
 public:
-	BuiltinType(TypeContext& ctx, std::string name, size_t bitSize) :
-		Type(ctx),
+	BuiltinType(TypeContext& ctx, Symbol name, size_t bitSize, bool isSigned, size_t index) :
+		Type(TypeKind::Builtin, ctx),
 		name(name),
-		bitSize(bitSize)
+		bitSize(bitSize),
+		isSigned(isSigned),
+		index(index)
 	{
 	}
 
 public:
 	virtual size_t getBitSize() override;
-	virtual bool isSame(Type* other) override;
-	virtual Type* getResolvedType() override;
 	virtual std::string toString() override;
+
+protected:
+	virtual Type* resolve() override;
 };
 
 class StructType : public Type
 {
 public:
-	std::string name;
-	std::vector<std::pair<std::string, Type*>> members;
+	Symbol name;
+	std::vector<std::pair<Symbol, Type*>> members;
+
+	// members are not padded and the struct is byte aligned
+	bool packed;
 
 public:
-	StructType(TypeContext& ctx, std::string name, std::vector<std::pair<std::string, Type*>> members) :
-		Type(ctx),
+	StructType(TypeContext& ctx, Symbol name, std::vector<std::pair<Symbol, Type*>> members, bool packed) :
+		Type(TypeKind::Struct, ctx),
 		name(name),
-		members(members)
+		members(members),
+		packed(packed)
 	{
 	}
 
 public:
 	virtual size_t getBitSize() override;
-	virtual bool isSame(Type* other) override;
-	virtual Type* getResolvedType() override;
 	virtual std::string toString() override;
+
+protected:
+	virtual Type* resolve() override;
 };
 
 class PointerType : public Type
@@ -100,16 +231,17 @@ public:
 
 public:
 	PointerType(Type* base) :
-		Type(base->ctx),
+		Type(TypeKind::Pointer, base->ctx),
 		base(base)
 	{
 	}
 
 public:
 	virtual size_t getBitSize() override;
-	virtual bool isSame(Type* other) override;
-	virtual Type* getResolvedType() override;
 	virtual std::string toString() override;
+
+protected:
+	virtual Type* resolve() override;
 };
 
 class ArrayType : public Type
@@ -119,33 +251,35 @@ public:
 
 public:
 	ArrayType(Type* base) :
-		Type(base->ctx),
+		Type(TypeKind::Array, base->ctx),
 		base(base)
 	{
 	}
 
 public:
 	virtual size_t getBitSize() override;
-	virtual bool isSame(Type* other) override;
-	virtual Type* getResolvedType() override;
 	virtual std::string toString() override;
+
+protected:
+	virtual Type* resolve() override;
 };
 
 class NamedType : public Type
 {
 public:
-	std::string name;
+	Symbol name;
 
 public:
-	NamedType(TypeContext& ctx, std::string name) :
-		Type(ctx),
+	NamedType(TypeContext& ctx, Symbol name) :
+		Type(TypeKind::Named, ctx),
 		name(name)
 	{
 	}
 
 public:
 	virtual size_t getBitSize() override;
-	virtual bool isSame(Type* other) override;
-	virtual Type* getResolvedType() override;
 	virtual std::string toString() override;
+
+protected:
+	virtual Type* resolve() override;
 };
\ No newline at end of file